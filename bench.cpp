@@ -0,0 +1,411 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "pool.h"
+
+
+/*******************************************
+ * allocators under test
+ *******************************************/
+template <int size>
+struct NewDelete {
+	static const char* name() { return "new/delete"; }
+	static void* get() { return new van::pool::Mem<size>; }
+	static void ret(void* p) { delete static_cast<van::pool::Mem<size>*>(p); }
+};
+
+template <int size>
+struct Malloc {
+	static const char* name() { return "malloc"; }
+	static void* get() { return malloc(size); }
+	static void ret(void* p) { free(p); }
+};
+
+template <int size>
+struct Tls {
+	static const char* name() { return "tls"; }
+	static void* get() { return van::pool::get_tls<size>(); }
+	static void ret(void* p) { van::pool::ret_tls(static_cast<van::pool::Mem<size>*>(p)); }
+};
+
+// tls pool with every check of the hardened mode on
+template <int size>
+struct Checked {
+	char buf_[size];
+};
+
+namespace van {
+	namespace pool {
+		template <int size>
+		struct PoolCheck<Checked<size>> {
+			static constexpr bool hardened = true;
+		};
+	}
+}
+
+template <int size>
+struct TlsHardened {
+	static const char* name() { return "hardened"; }
+	static void* get() { return van::pool::get_tls<Checked<size>>(); }
+	static void ret(void* p) { van::pool::ret_tls(static_cast<Checked<size>*>(p)); }
+};
+
+template <int size>
+struct Singleton {
+	static const char* name() { return "singleton"; }
+	static void* get() { return van::pool::get_singleton<size>(); }
+	static void ret(void* p) { van::pool::ret_singleton(static_cast<van::pool::Mem<size>*>(p)); }
+};
+
+template <int size>
+struct LockFree {
+	static const char* name() { return "lockfree"; }
+	static void* get() { return van::pool::get_lockfree<size>(); }
+	static void ret(void* p) { van::pool::ret_lockfree(static_cast<van::pool::Mem<size>*>(p)); }
+};
+
+template <int size>
+struct Cached {
+	static const char* name() { return "cached"; }
+	static void* get() { return van::pool::get_cached<size>(); }
+	static void ret(void* p) { van::pool::ret_cached(static_cast<van::pool::Mem<size>*>(p)); }
+};
+
+template <int size>
+struct PerCpu {
+	static const char* name() { return "per-cpu"; }
+	static void* get() { return van::pool::get_cpu<size>(); }
+	static void ret(void* p) { van::pool::ret_cpu(static_cast<van::pool::Mem<size>*>(p)); }
+};
+
+template <int size>
+struct SizeClassed {
+	static const char* name() { return "size-class"; }
+	static void* get() { return van::pool::alloc(size); }
+	static void ret(void* p) { van::pool::dealloc(p, size); }
+};
+
+
+/*******************************************
+ * measurement
+ *  - every SAMPLE-th operation is timed on its own for the percentiles
+ *******************************************/
+using Clock = std::chrono::steady_clock;
+
+static const uint64_t SAMPLE = 16;
+
+static uint32_t elapsed_ns(Clock::time_point start) noexcept
+{
+	return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+class Result {
+public:
+	uint64_t ops_ = 0;
+	double msec_ = 0;
+	std::vector<uint32_t> lat_;
+
+	double percentile(double p) noexcept
+	{
+		if (lat_.empty()) return 0;
+		size_t idx = static_cast<size_t>(p * (lat_.size() - 1));
+		std::nth_element(lat_.begin(), lat_.begin() + idx, lat_.end());
+		return lat_[idx];
+	}
+};
+
+template <class Func>
+Result run_threads(int thread_cnt, Func func)
+{
+	std::vector<std::vector<uint32_t>> lats(thread_cnt);
+	std::vector<std::thread> threads;
+	std::atomic<int> ready{0};
+	std::atomic<bool> go{false};
+
+	for (int i=0; i<thread_cnt; ++i) {
+		threads.emplace_back([&, i]() {
+			++ready;
+			while (!go.load()) std::this_thread::yield();
+			func(i, lats[i]);
+		});
+	}
+	while (ready.load() != thread_cnt) std::this_thread::yield();
+
+	Clock::time_point start = Clock::now();
+	go = true;
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	Result r;
+	r.msec_ = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	for (auto& lat : lats) {
+		r.lat_.insert(r.lat_.end(), lat.begin(), lat.end());
+	}
+	return r;
+}
+
+static void touch(void* p) noexcept
+{
+	*static_cast<volatile char*>(p) = 1;
+}
+
+
+/*******************************************
+ * workloads
+ *******************************************/
+
+// get and ret back to back on every thread
+template <class A>
+Result churn(int thread_cnt, uint64_t ops)
+{
+	Result r = run_threads(thread_cnt, [ops](int, std::vector<uint32_t>& lat) {
+		lat.reserve(ops / SAMPLE + 1);
+		for (uint64_t i=0; i<ops; ++i) {
+			if (i % SAMPLE == 0) {
+				Clock::time_point start = Clock::now();
+				void* p = A::get();
+				touch(p);
+				A::ret(p);
+				lat.push_back(elapsed_ns(start));
+			} else {
+				void* p = A::get();
+				touch(p);
+				A::ret(p);
+			}
+		}
+	});
+	r.ops_ = ops * thread_cnt;
+	return r;
+}
+
+// each slot keeps an object alive for a random number of operations
+template <class A>
+Result random_lifetime(int thread_cnt, uint64_t ops)
+{
+	static const size_t WINDOW = 1024;
+
+	Result r = run_threads(thread_cnt, [ops](int id, std::vector<uint32_t>& lat) {
+		std::mt19937 rng(id + 1);
+		std::vector<void*> slots(WINDOW, nullptr);
+		lat.reserve(ops / SAMPLE + 1);
+
+		for (uint64_t i=0; i<ops; ++i) {
+			void*& slot = slots[rng() % WINDOW];
+			Clock::time_point start;
+			bool sample = (i % SAMPLE == 0);
+			if (sample) start = Clock::now();
+
+			if (slot) A::ret(slot);
+			slot = A::get();
+			touch(slot);
+
+			if (sample) lat.push_back(elapsed_ns(start));
+		}
+		for (void* p : slots) {
+			if (p) A::ret(p);
+		}
+	});
+	r.ops_ = ops * thread_cnt;
+	return r;
+}
+
+// single producer, single consumer ring
+class Ring {
+private:
+	static const size_t CAP = 1024;
+	std::atomic<void*> slots_[CAP];
+	alignas(64) std::atomic<uint64_t> head_{0};
+	alignas(64) std::atomic<uint64_t> tail_{0};
+
+public:
+	Ring() noexcept
+	{
+		for (auto& s : slots_) s.store(nullptr);
+	}
+
+	void push(void* p) noexcept
+	{
+		uint64_t tail = tail_.load(std::memory_order_relaxed);
+		while (tail - head_.load(std::memory_order_acquire) >= CAP) std::this_thread::yield();
+		slots_[tail % CAP].store(p, std::memory_order_relaxed);
+		tail_.store(tail + 1, std::memory_order_release);
+	}
+
+	void* pop() noexcept
+	{
+		uint64_t head = head_.load(std::memory_order_relaxed);
+		while (tail_.load(std::memory_order_acquire) == head) std::this_thread::yield();
+		void* p = slots_[head % CAP].load(std::memory_order_relaxed);
+		head_.store(head + 1, std::memory_order_release);
+		return p;
+	}
+};
+
+// even threads allocate, odd threads free what their partner allocated
+template <class A>
+Result producer_consumer(int thread_cnt, uint64_t ops)
+{
+	int pairs = std::max(1, thread_cnt / 2);
+	std::vector<Ring> rings(pairs);
+
+	Result r = run_threads(pairs * 2, [ops, &rings](int id, std::vector<uint32_t>& lat) {
+		Ring& ring = rings[id / 2];
+		lat.reserve(ops / SAMPLE + 1);
+
+		if (id % 2 == 0) {
+			for (uint64_t i=0; i<ops; ++i) {
+				if (i % SAMPLE == 0) {
+					Clock::time_point start = Clock::now();
+					void* p = A::get();
+					touch(p);
+					lat.push_back(elapsed_ns(start));
+					ring.push(p);
+				} else {
+					void* p = A::get();
+					touch(p);
+					ring.push(p);
+				}
+			}
+		} else {
+			for (uint64_t i=0; i<ops; ++i) {
+				void* p = ring.pop();
+				if (i % SAMPLE == 0) {
+					Clock::time_point start = Clock::now();
+					A::ret(p);
+					lat.push_back(elapsed_ns(start));
+				} else {
+					A::ret(p);
+				}
+			}
+		}
+	});
+	r.ops_ = ops * pairs * 2;
+	return r;
+}
+
+
+/*******************************************
+ * block provider
+ *  - pointer chase in random order over a large pool, so nearly every
+ *    access misses the tlb unless the blocks sit on huge pages
+ *******************************************/
+static const size_t CHASE_OBJS = size_t(1) << 22;
+
+struct Node {
+	Node* next_;
+	char pad_[56];
+};
+
+static double chase(van::pool::Provider provider)
+{
+	van::pool::Pool<Node> pool(1 << 16, van::pool::Growth::doubling(), provider);
+	std::vector<Node*> nodes(CHASE_OBJS);
+	for (auto& n : nodes) n = pool.get();
+
+	std::shuffle(nodes.begin(), nodes.end(), std::mt19937(1));
+	for (size_t i=0; i<CHASE_OBJS; ++i) {
+		nodes[i]->next_ = nodes[(i + 1) % CHASE_OBJS];
+	}
+
+	Clock::time_point start = Clock::now();
+	Node* n = nodes[0];
+	for (size_t i=0; i<CHASE_OBJS; ++i) {
+		n = n->next_;
+	}
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / CHASE_OBJS;
+	touch(n);
+
+	for (auto& node : nodes) pool.ret(node);
+	return ns;
+}
+
+static void bench_provider()
+{
+	printf("  %-18s %10s\n", "PROVIDER", "NS/ACCESS");
+	printf("  %-18s %10.2f\n", "heap", chase(van::pool::Provider::heap()));
+	printf("  %-18s %10.2f\n", "mapped", chase(van::pool::Provider::mapped()));
+	printf("  %-18s %10.2f\n", "huge", chase(van::pool::Provider::huge()));
+	printf("\n");
+}
+
+
+/*******************************************
+ * driver
+ *******************************************/
+static uint64_t OPS = 200000;
+static int MAX_THREAD = 4;
+
+static void print(const char* workload, const char* alloc, int size, int thread_cnt, Result r)
+{
+	printf(
+		"  %-18s %-11s %6d %3d %10.2f %8.0f %8.0f %8.0f\n",
+		workload, alloc, size, thread_cnt,
+		r.ops_ / r.msec_ / 1000.0,
+		r.percentile(0.5), r.percentile(0.99), r.percentile(0.999)
+	);
+}
+
+template <template <int> class A, int size>
+void bench_alloc()
+{
+	using Alloc = A<size>;
+
+	for (int t=1; t<=MAX_THREAD; t*=2) {
+		print("churn", Alloc::name(), size, t, churn<Alloc>(t, OPS));
+	}
+	for (int t=1; t<=MAX_THREAD; t*=2) {
+		print("random-lifetime", Alloc::name(), size, t, random_lifetime<Alloc>(t, OPS));
+	}
+	for (int t=2; t<=MAX_THREAD; t*=2) {
+		print("producer-consumer", Alloc::name(), size, t, producer_consumer<Alloc>(t, OPS));
+	}
+}
+
+template <int size>
+void bench_size()
+{
+	bench_alloc<NewDelete, size>();
+	bench_alloc<Malloc, size>();
+	bench_alloc<Tls, size>();
+	bench_alloc<TlsHardened, size>();
+	bench_alloc<Singleton, size>();
+	bench_alloc<LockFree, size>();
+	bench_alloc<Cached, size>();
+	bench_alloc<PerCpu, size>();
+	bench_alloc<SizeClassed, size>();
+	printf("\n");
+}
+
+
+// usage : bench [ops per thread] [max threads]
+int main(int argc, char* argv[])
+{
+	if (argc > 1) OPS = strtoull(argv[1], nullptr, 10);
+	if (argc > 2) MAX_THREAD = atoi(argv[2]);
+	if (MAX_THREAD < 2) MAX_THREAD = 2;
+
+	printf(
+		"  %-18s %-11s %6s %3s %10s %8s %8s %8s\n",
+		"WORKLOAD", "ALLOC", "SIZE", "THR", "MOPS/S", "P50(ns)", "P99(ns)", "P99.9"
+	);
+
+	bench_size<8>();
+	bench_size<64>();
+	bench_size<512>();
+	bench_size<4096>();
+	bench_size<65536>();
+
+	bench_provider();
+
+	van::pool::print_stat();
+
+	return 0;
+}
@@ -3,3 +3,10 @@
 #g++ -g -std=c++11 -pthread -o app main.cpp
 g++ -g -O2 -std=c++11 -pthread -o app main.cpp
 
+g++ -g -O2 -std=c++11 -pthread -o bench bench.cpp
+
+# c++17 : the same examples plus the pmr resource
+g++ -g -O2 -std=c++17 -pthread -o app_pmr main.cpp
+
+# self-checking tests, nonzero exit on failure
+g++ -g -O2 -std=c++17 -pthread -o test test.cpp
@@ -1,9 +1,28 @@
 
 #include <stdio.h>
 #include <chrono>
+#include <thread>
+#include <map>
+#include <memory>
+#include <vector>
 #include "pool.h"
 
 
+struct Packed {
+	uint64_t v_;
+};
+
+namespace van {
+	namespace pool {
+		template <>
+		struct PoolLayout<Packed> {
+			static constexpr bool compact = true;
+			static constexpr size_t span = size_t(1) << 16;
+		};
+	}
+}
+
+
 class ElapsedTimer {
 	private:
 		using Clock = std::chrono::high_resolution_clock;
@@ -23,6 +42,21 @@ class ElapsedTimer {
 };
 
 
+template <class Func>
+double run_threads(int thread_cnt, Func func)
+{
+	std::vector<std::thread> threads;
+	ElapsedTimer timer;
+
+	timer.start();
+	for (int i=0; i<thread_cnt; ++i) {
+		threads.emplace_back(func);
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	return timer.stop();
+}
 
 
 int main()
@@ -49,6 +83,24 @@ int main()
 	}
 	printf("  %-20s : %lf msec\n", "tls class pool", timer.stop());
 
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		van::pool::Pooled<Test> t = van::pool::make_pooled<Test>();
+	}
+	printf("  %-20s : %lf msec\n", "tls make_pooled", timer.stop());
+
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		std::shared_ptr<Test> t = std::make_shared<Test>();
+	}
+	printf("  %-20s : %lf msec\n", "make_shared", timer.stop());
+
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		std::shared_ptr<Test> t = van::pool::make_pooled_shared<Test>();
+	}
+	printf("  %-20s : %lf msec\n", "make_pooled_shared", timer.stop());
+
 	timer.start();
 	for (uint64_t i=0; i<LOOP; ++i) {
 		Test* t1 = van::pool::get_singleton<Test>();
@@ -56,6 +108,14 @@ int main()
 	}
 	printf("  %-20s : %lf msec\n", "singleton class pool", timer.stop());
 
+	timer.start();
+	for (uint64_t i=0; i<LOOP/64; ++i) {
+		Test* t[64];
+		van::pool::get_singleton_n(t, 64);
+		van::pool::ret_singleton_n(t, 64);
+	}
+	printf("  %-20s : %lf msec\n", "singleton batch(64)", timer.stop());
+
 	timer.start();
 	for (uint64_t i=0; i<LOOP; ++i) {
 		van::pool::Mem<1024>* t = van::pool::get_tls<1024>();
@@ -63,6 +123,52 @@ int main()
 	}
 	printf("  %-20s : %lf msec\n", "tls mem pool", timer.stop());
 
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		van::pool::Mem<1024, 64>* t = van::pool::get_tls<van::pool::Mem<1024, 64>>();
+		van::pool::ret_tls(t);
+	}
+	printf("  %-20s : %lf msec\n", "tls aligned mem pool", timer.stop());
+
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		Packed* t = van::pool::get_tls<Packed>();
+		van::pool::ret_tls(t);
+	}
+	printf("  %-20s : %lf msec\n", "tls compact pool", timer.stop());
+
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		size_t size = 16 + (i & 1023);
+		void* t = van::pool::alloc(size);
+		van::pool::dealloc(t, size);
+	}
+	printf("  %-20s : %lf msec\n", "size class alloc", timer.stop());
+
+	uint64_t MAP_LOOP = 100;
+	timer.start();
+	for (uint64_t i=0; i<MAP_LOOP; ++i) {
+		std::map<int, int> m;
+		for (int k=0; k<10000; ++k) m[k] = k;
+	}
+	printf("  %-20s : %lf msec\n", "std::map", timer.stop());
+
+	timer.start();
+	for (uint64_t i=0; i<MAP_LOOP; ++i) {
+		std::map<int, int, std::less<int>, van::pool::Allocator<std::pair<const int, int>>> m;
+		for (int k=0; k<10000; ++k) m[k] = k;
+	}
+	printf("  %-20s : %lf msec\n", "pooled std::map", timer.stop());
+
+#ifdef VAN_POOL_PMR
+	timer.start();
+	for (uint64_t i=0; i<MAP_LOOP; ++i) {
+		std::pmr::map<int, int> m(van::pool::get_tls_resource());
+		for (int k=0; k<10000; ++k) m[k] = k;
+	}
+	printf("  %-20s : %lf msec\n", "pmr std::map", timer.stop());
+#endif
+
 	timer.start();
 	for (uint64_t i=0; i<LOOP; ++i) {
 		van::pool::Mem<1024>* t = van::pool::get_singleton<1024>();
@@ -70,6 +176,103 @@ int main()
 	}
 	printf("  %-20s : %lf msec\n", "singleton mem pool", timer.stop());
 
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		Test* t = van::pool::get_lockfree<Test>();
+		van::pool::ret_lockfree(t);
+	}
+	printf("  %-20s : %lf msec\n", "lockfree class pool", timer.stop());
+
+	timer.start();
+	for (uint64_t i=0; i<LOOP; ++i) {
+		Test* t = van::pool::get_cached<Test>();
+		van::pool::ret_cached(t);
+	}
+	printf("  %-20s : %lf msec\n", "cached class pool", timer.stop());
+
+
+	printf("\n\n---------------------------------------------------------------------------------------------\n");
+
+	int max_thread = static_cast<int>(std::thread::hardware_concurrency());
+	if (max_thread < 4) max_thread = 4;
+
+	uint64_t MT_LOOP = 10000000;
+	for (int thread_cnt=1; thread_cnt<=max_thread; thread_cnt*=2) {
+		uint64_t loop = MT_LOOP / thread_cnt;
+
+		double mutex_ms = run_threads(thread_cnt, [loop]() {
+			for (uint64_t i=0; i<loop; ++i) {
+				Test* t = van::pool::get_singleton<Test>();
+				van::pool::ret_singleton(t);
+			}
+		});
+
+		double lockfree_ms = run_threads(thread_cnt, [loop]() {
+			for (uint64_t i=0; i<loop; ++i) {
+				Test* t = van::pool::get_lockfree<Test>();
+				van::pool::ret_lockfree(t);
+			}
+		});
+
+		double cached_ms = run_threads(thread_cnt, [loop]() {
+			for (uint64_t i=0; i<loop; ++i) {
+				Test* t = van::pool::get_cached<Test>();
+				van::pool::ret_cached(t);
+			}
+		});
+
+		double numa_ms = run_threads(thread_cnt, [loop]() {
+			for (uint64_t i=0; i<loop; ++i) {
+				Test* t = van::pool::get_numa<Test>();
+				van::pool::ret_numa(t);
+			}
+		});
+
+		double cpu_ms = run_threads(thread_cnt, [loop]() {
+			for (uint64_t i=0; i<loop; ++i) {
+				Test* t = van::pool::get_cpu<Test>();
+				van::pool::ret_cpu(t);
+			}
+		});
+
+		printf("  %2d threads : singleton %10lf msec, lockfree %10lf msec, cached %10lf msec, numa %10lf msec, cpu %10lf msec\n", thread_cnt, mutex_ms, lockfree_ms, cached_ms, numa_ms, cpu_ms);
+	}
+
+
+	printf("\n\n---------------------------------------------------------------------------------------------\n");
+
+	uint64_t RAMP = 4000000;
+	std::vector<Test*> objs(RAMP);
+
+	{
+		van::pool::Pool<Test> pool(0, van::pool::Growth::fixed());
+		timer.start();
+		for (uint64_t i=0; i<RAMP; ++i) {
+			objs[i] = pool.get();
+		}
+		printf("  %-20s : %lf msec\n", "ramp fixed", timer.stop());
+		for (uint64_t i=0; i<RAMP; ++i) {
+			pool.ret(objs[i]);
+		}
+	}
+
+	{
+		van::pool::Pool<Test> pool(0, van::pool::Growth::doubling());
+		timer.start();
+		for (uint64_t i=0; i<RAMP; ++i) {
+			objs[i] = pool.get();
+		}
+		printf("  %-20s : %lf msec\n", "ramp doubling", timer.stop());
+		for (uint64_t i=0; i<RAMP; ++i) {
+			pool.ret(objs[i]);
+		}
+
+		uint64_t reserved = pool.reserved_bytes();
+		timer.start();
+		uint64_t released = pool.trim();
+		printf("  %-20s : %lf msec, %" PRIu64 " / %" PRIu64 " bytes released\n", "trim", timer.stop(), released, reserved);
+	}
+
 
 	printf("\n\n---------------------------------------------------------------------------------------------\n");
 	van::pool::print_stat();
@@ -1,425 +1,4062 @@
 #pragma once
 
 #include <cinttypes>
+#include <cstddef>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
 
 #include <typeindex>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <memory>
+#include <string>
+#include <functional>
+
+#if defined(_MSVC_LANG)
+#define VAN_POOL_CPLUSPLUS _MSVC_LANG
+#else
+#define VAN_POOL_CPLUSPLUS __cplusplus
+#endif
+
+#if VAN_POOL_CPLUSPLUS >= 201703L
+#include <memory_resource>
+#define VAN_POOL_PMR 1
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define VAN_POOL_MMAP 1
+#endif
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <sched.h>
+#define VAN_POOL_NUMA 1
+#endif
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#define VAN_POOL_BACKTRACE 1
+#endif
+#include <utility>
+
+#ifndef VAN_POOL_COMPACT
+#define VAN_POOL_COMPACT 0
+#endif
+
+#ifndef VAN_POOL_MAGAZINE_SIZE
+#define VAN_POOL_MAGAZINE_SIZE 64
+#endif
+
+// full magazines a depot keeps, the objects of any more go back to its pool
+#ifndef VAN_POOL_DEPOT_FULL
+#define VAN_POOL_DEPOT_FULL 8
+#endif
+
+// 0 : no use counting on get/ret, Monitor reports use as 0
+#ifndef VAN_POOL_STATS
+#define VAN_POOL_STATS 1
+#endif
+
+// 1 : every pool checks its objects, see PoolCheck
+#ifndef VAN_POOL_HARDENED
+#define VAN_POOL_HARDENED 0
+#endif
+
+// asan builds poison free objects, found on its own
+#if defined(__SANITIZE_ADDRESS__)
+#define VAN_POOL_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define VAN_POOL_ASAN 1
+#endif
+#endif
+
+#ifdef VAN_POOL_ASAN
+#include <sanitizer/asan_interface.h>
+#endif
+
+// reads a poisoned word without a report, for peeks at memory another thread owns
+#if defined(VAN_POOL_ASAN) && defined(__GNUC__)
+#define VAN_POOL_NO_ASAN __attribute__((no_sanitize_address))
+#else
+#define VAN_POOL_NO_ASAN
+#endif
+
+// 1 : valgrind mempool client requests, needs valgrind/memcheck.h
+#ifndef VAN_POOL_VALGRIND
+#define VAN_POOL_VALGRIND 0
+#endif
+
+#if VAN_POOL_VALGRIND
+#include <valgrind/memcheck.h>
+#endif
 
 namespace van {
 	namespace pool {
 
 		
-		template <class T>
-		class Pool;
-
-		using Pools = std::unordered_map<std::type_index, std::unordered_set<Pool<void>*>>;
+		class PoolBase;
 
-		class IMonitor {
+		/*******************************************
+		 * registry
+		 *  - every live pool holds one slot, Monitor walks the slots
+		 *  - slots are type-stable : recycled through a tagged free stack and only
+		 *    freed at exit, so register and deregister are O(1), lock-free and
+		 *    allocate only past the highest pool count seen
+		 *  - a walker pins a slot before reading its pool, deregister clears the
+		 *    pool and waits out pinned walkers (only a running stat)
+		 *******************************************/
+		class Registry {
 		public:
-			virtual void created(std::type_index& tidx, Pool<void>* pool) noexcept = 0;
-			virtual void deleted(std::type_index& tidx, Pool<void>* pool) noexcept = 0;
-		};
-
+			class Slot {
+			public:
+				std::atomic<PoolBase*> pool_{nullptr};
+				std::atomic<const std::type_info*> type_{nullptr};
+				std::atomic<int> readers_{0};
+				std::atomic<Slot*> free_next_{nullptr};
+				Slot* next_ = nullptr;		// every slot, fixed once published
+			};
 
-		class Channel {
 		private:
-			std::mutex mutex_;
-			Pools pools_;
+			static constexpr int ptr_bits_ = (sizeof(void*) == 8) ? 48 : 32;
+			static constexpr uint64_t ptr_mask_ = (uint64_t(1) << ptr_bits_) - 1;
 
-			IMonitor* mon_ = nullptr;
+			std::atomic<Slot*> slots_{nullptr};
+			std::atomic<uint64_t> free_{0};		// tag << ptr_bits_ | slot
 
 		public:
-			Channel() = default;
-			Channel(const Channel&) = delete;
-			Channel& operator=(const Channel&) = delete;
+			Registry() = default;
+			Registry(const Registry&) = delete;
+			Registry& operator=(const Registry&) = delete;
 
-			static Channel& inst()
+			~Registry() noexcept
 			{
-				static Channel inst;
-				return inst;
+				Slot* slot = slots_.load(std::memory_order_acquire);
+				while (slot) {
+					Slot* next = slot->next_;
+					delete slot;
+					slot = next;
+				}
 			}
 
-			void set(IMonitor* mon) noexcept
+			static Registry& inst() noexcept
 			{
-				std::lock_guard<std::mutex> lock(mutex_);
-				mon_ = mon;
-				pass_all();
+				static Registry inst;
+				return inst;
 			}
 
-			template <class T>
-			void created(Pool<T>* p) noexcept
+			Slot* created(PoolBase* p, const std::type_info& type) noexcept
 			{
-				std::type_index tidx = typeid(T);
-				Pool<void>* pool = reinterpret_cast<Pool<void>*>(p);
+				Slot* slot = pop_free();
+				if (!slot) {
+					slot = new Slot;
+					Slot* head = slots_.load(std::memory_order_relaxed);
+					do {
+						slot->next_ = head;
+					} while (!slots_.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+				}
 
-				std::lock_guard<std::mutex> lock(mutex_);
+				slot->type_.store(&type, std::memory_order_relaxed);
+				slot->pool_.store(p, std::memory_order_release);
+				return slot;
+			}
 
-				if (mon_) {
-					mon_->created(tidx, pool);
-					pass_all();
-				} else {
-					pools_[tidx].insert(pool);
+			// seq_cst pairs with for_each : either the walker sees nullptr or we see its pin
+			void deleted(Slot* slot) noexcept
+			{
+				slot->pool_.store(nullptr, std::memory_order_seq_cst);
+				while (slot->readers_.load(std::memory_order_seq_cst) != 0) {
+					std::this_thread::yield();
 				}
+				push_free(slot);
 			}
 
-			template <class T>
-			void deleted(Pool<T>* p) noexcept
+			// func(type, pool) for every live pool, the pool outlives the call
+			template <class Func>
+			void for_each(Func func) noexcept
 			{
-				std::type_index tidx = typeid(T);
-				Pool<void>* pool = reinterpret_cast<Pool<void>*>(p);
-
-				std::lock_guard<std::mutex> lock(mutex_);
-
-				if (mon_) {
-					mon_->deleted(tidx, pool);
-					pass_all();
-				} else {
-					pools_[tidx].erase(pool);
+				for (Slot* slot = slots_.load(std::memory_order_acquire); slot; slot = slot->next_) {
+					slot->readers_.fetch_add(1, std::memory_order_seq_cst);
+					PoolBase* pool = slot->pool_.load(std::memory_order_seq_cst);
+					if (pool) {
+						func(*slot->type_.load(std::memory_order_relaxed), pool);
+					}
+					slot->readers_.fetch_sub(1, std::memory_order_release);
 				}
 			}
 
 		private:
-			void pass_all() noexcept
+			static Slot* ptr(uint64_t v) noexcept
 			{
-				if (!mon_) return;
-				if (pools_.empty()) return;
+				return reinterpret_cast<Slot*>(static_cast<uintptr_t>(v & ptr_mask_));
+			}
 
-				for (auto it : pools_) {
-					auto tidx = it.first;
-					auto& poolset = it.second;
+			static uint64_t pack(Slot* slot, uint64_t tag) noexcept
+			{
+				return (tag << ptr_bits_) | (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(slot)) & ptr_mask_);
+			}
 
-					for (auto pool : poolset) {
-						mon_->created(tidx, pool);
+			Slot* pop_free() noexcept
+			{
+				uint64_t head = free_.load(std::memory_order_acquire);
+				for (;;) {
+					Slot* slot = ptr(head);
+					if (!slot) return nullptr;
+
+					uint64_t next = pack(slot->free_next_.load(std::memory_order_relaxed), (head >> ptr_bits_) + 1);
+					if (free_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+						return slot;
 					}
 				}
 			}
 
+			void push_free(Slot* slot) noexcept
+			{
+				uint64_t head = free_.load(std::memory_order_relaxed);
+				do {
+					slot->free_next_.store(ptr(head), std::memory_order_relaxed);
+				} while (!free_.compare_exchange_weak(head, pack(slot, head >> ptr_bits_), std::memory_order_release, std::memory_order_relaxed));
+			}
 		};
 
+		/*******************************************
+		 * alignment
+		 *  - objects are aligned to PoolAlign<T>::value (alignof(T) by default)
+		 *  - specialize it to pool a type on cache line or page boundaries
+		 *******************************************/
 		template <class T>
-		class Pool {
-		private:
-
-			struct Obj {
-				T inst_;
-				Obj* next_;
-			};
-			Obj* curr_ = nullptr;
-			Obj* last_ = nullptr;
-			Obj* free_ = nullptr;
+		struct PoolAlign {
+			static constexpr size_t value = alignof(T);
+		};
 
-			struct Block {
-				Block* next_;
-			};
-			Block* blocks_ = nullptr;
+		inline void* aligned_malloc(size_t bytes, size_t align) noexcept
+		{
+			if (align < sizeof(void*)) align = sizeof(void*);
+#if defined(_WIN32)
+			return _aligned_malloc(bytes, align);
+#else
+			void* p = nullptr;
+			if (posix_memalign(&p, align, bytes) != 0) return nullptr;
+			return p;
+#endif
+		}
 
-			int cnt_ = 128;
+		inline void aligned_free(void* p) noexcept
+		{
+#if defined(_WIN32)
+			_aligned_free(p);
+#else
+			free(p);
+#endif
+		}
 
-			uint64_t total_cnt_ = 0;
-			uint64_t use_cnt_ = 0;
 
-		public:
-			using value_type = T;
+		/*******************************************
+		 * object layout
+		 *  - default : each object keeps a pointer to its block
+		 *  - compact : no per-object word, blocks are aligned to span and
+		 *              found by masking, growth is capped at one span per block
+		 *******************************************/
+		template <class T>
+		struct PoolLayout {
+			static constexpr bool compact = (VAN_POOL_COMPACT != 0);
+			static constexpr size_t span = size_t(1) << 16;
+		};
 
-		public:
 
-			Pool(int cnt = 0) noexcept
-			{
-				if (cnt > 0) {
-					cnt_ = cnt;
-					new_block();
-				}
+		/*******************************************
+		 * hardened mode
+		 *  - free list links are stored xor a per-process key and the slot address
+		 *  - each object carries a canary word after it : live or free, bound to its link
+		 *  - returned objects are poisoned, a write after return shows on the next get
+		 *  - ret checks the canary and that the pointer is an object of its block
+		 *  - hardened objects always keep the default layout, compact is ignored
+		 *  - a fault prints the caller stack and aborts, unless a handler is set :
+		 *    then ret drops the pointer and get skips the broken free list
+		 *******************************************/
+		template <class T>
+		struct PoolCheck {
+			static constexpr bool hardened = (VAN_POOL_HARDENED != 0);
+		};
 
-				Channel::inst().created(this);
+		// type names for reports and exporters
+		inline std::string demangle(const char* name)
+		{
+#if defined(__GNUG__)
+			int status = 0;
+			char* p = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+			if (status == 0 && p) {
+				std::string s(p);
+				free(p);
+				return s;
 			}
+#endif
+			return name;
+		}
 
-			~Pool() noexcept
-			{
-				Channel::inst().deleted(this);
 
-				Block* block = blocks_;
-				while (block) {
-					Block* next = block->next_;
-					free(block);
-					block = next;
-				}
-			}
+		class Hardened {
+		public:
+			enum class Fault { double_ret, foreign, overflow, use_after_ret, bad_link };
+			// type : the demangled name of T
+			using Handler = void (*)(Fault fault, const char* type, const void* p);
 
-			Pool(const Pool<T>&) = delete;
-			Pool& operator=(const Pool<T>&) = delete;
+			static constexpr unsigned char poison_ = 0xdb;
 
-			T* get() noexcept
+			static const char* name(Fault fault) noexcept
 			{
-				++use_cnt_;
-
-				if (free_) {
-					Obj* obj = free_;
-					free_ = free_->next_;
-					return &(obj->inst_);
-				}
-				if (curr_ >= last_) {
-					new_block();
+				switch (fault) {
+				case Fault::double_ret: return "double ret";
+				case Fault::foreign: return "foreign pointer";
+				case Fault::overflow: return "overflow";
+				case Fault::use_after_ret: return "use after ret";
+				case Fault::bad_link: return "corrupted free list";
 				}
-				return &((curr_++)->inst_);
-				
+				return "unknown";
 			}
 
-			void ret(T* t) noexcept
+			// returns the previous handler, nullptr restores report and abort
+			static Handler set_handler(Handler handler) noexcept
 			{
-				--use_cnt_;
-				
-				Obj* obj = reinterpret_cast<Obj*>(t);
-				obj->next_ = free_;
-				free_ = obj;
+				return handler_().exchange(handler);
 			}
 
+			static void fault(Fault fault, const char* type, const void* p) noexcept
+			{
+				Handler handler = handler_().load();
+				if (handler) {
+					handler(fault, type, p);
+					return;
+				}
 
-			uint64_t total_cnt() noexcept
+				fprintf(stderr, "van::pool : %s of %s at %p\n", name(fault), type, p);
+#ifdef VAN_POOL_BACKTRACE
+				void* frames[64];
+				int cnt = backtrace(frames, 64);
+				backtrace_symbols_fd(frames, cnt, fileno(stderr));
+#endif
+				abort();
+			}
+
+			// odd : the live canary, key ^ an aligned address, is never zero
+			static uintptr_t key() noexcept
 			{
-				return total_cnt_;
+				static const uintptr_t key = make_key();
+				return key;
 			}
 
-			uint64_t use_cnt() noexcept
+			static uintptr_t mask(const void* slot) noexcept
 			{
-				return use_cnt_;
+				return key() ^ reinterpret_cast<uintptr_t>(slot);
 			}
 
 		private:
-			void new_block() noexcept
+			static std::atomic<Handler>& handler_() noexcept
 			{
-				Block* block = reinterpret_cast<Block*>(malloc(sizeof(Block) + (sizeof(Obj) * cnt_)));
-				block->next_ = blocks_;
-				blocks_ = block;
-
-				curr_ = reinterpret_cast<Obj*>(block + 1);
-				last_  = curr_ + cnt_;
-
-				total_cnt_ += cnt_;
+				static std::atomic<Handler> handler{nullptr};
+				return handler;
 			}
 
+			static uintptr_t make_key() noexcept
+			{
+				uint64_t x = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+				x ^= static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&x));
+				x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+				x ^= x >> 31;
+				return static_cast<uintptr_t>(x) | 1;
+			}
 		};
 
-		template <int size>
-		class Mem {
+
+		/*******************************************
+		 * block growth policy
+		 *  - fixed : every block holds the same count
+		 *  - doubling : each block doubles the last one, up to cap
+		 *  - custom : next count from the last count and the pool total
+		 *******************************************/
+		class Growth {
+		public:
+			using Func = int (*)(int last, uint64_t total);
+
 		private:
-			static_assert(size > 0, "too small size");
+			enum class Kind { fixed, doubling, custom };
+
+			Kind kind_ = Kind::fixed;
+			int cap_ = 0;
+			Func func_ = nullptr;
 
 		public:
-			static constexpr int len_ = size;
-			char buf_[size];
-		};
+			Growth() = default;
 
+			static Growth fixed() noexcept
+			{
+				return Growth();
+			}
 
+			static Growth doubling(int cap = 1 << 20) noexcept
+			{
+				Growth g;
+				g.kind_ = Kind::doubling;
+				g.cap_ = cap;
+				return g;
+			}
 
-		/*******************************************
-		 * call construct, destruct
-		 *******************************************/
-		template <class T, class... Args>
-		void construct(T* t, Args&&... args) noexcept
-		{
-			new (t) T (std::forward<Args>(args)...);
-		}
+			static Growth custom(Func func) noexcept
+			{
+				Growth g;
+				g.kind_ = Kind::custom;
+				g.func_ = func;
+				return g;
+			}
 
-		template <class T>
-		void destruct(T* t) noexcept
-		{
-			t->~T();
-		}
+			int next(int last, uint64_t total) const noexcept
+			{
+				int cnt = last;
+				switch (kind_) {
+				case Kind::fixed:
+					break;
+				case Kind::doubling:
+					cnt = (last >= cap_ / 2) ? cap_ : last * 2;
+					if (cnt < last) cnt = last;
+					break;
+				case Kind::custom:
+					cnt = func_(last, total);
+					break;
+				}
+				return (cnt > 0) ? cnt : 1;
+			}
+		};
 
 
 		/*******************************************
-		 * tls pool
+		 * block provider
+		 *  - heap : aligned_malloc (default)
+		 *  - mapped : anonymous mmap, pages go back to the os on release
+		 *  - huge : MAP_HUGETLB, or transparent huge pages when none are reserved
+		 *  - reserved : carved from a Reserve range, constructed before the first pool
+		 *               of the type so it also outlives blocks orphaned until exit
+		 *  - numa : mapped (or huge) and bound to a node before the first touch
+		 *  - numa_local : numa on the node of the thread that allocates the block,
+		 *                 looked up per block, so one provider serves every thread
+		 *  - custom : alloc/free functions with a context pointer
+		 *  - a provider that returns nullptr falls back to heap for that block
+		 *  - unit : what the provider rounds a block up to (a page, a huge page), pools
+		 *           fill the whole rounded block with objects and count it as reserved
 		 *******************************************/
-		template <class T>
-		Pool<T>& get_tls_pool(int cnt = 0) noexcept
+		inline size_t round_up(size_t bytes, size_t unit) noexcept
 		{
-			thread_local Pool<T> pool(cnt);
-			return pool;
+			return (bytes + unit - 1) / unit * unit;
 		}
 
-		template <class T> 
-		void warm_up_tls_pool(int cnt) noexcept
-		{
-			get_tls_pool<T>(cnt);
-		}
+#ifdef VAN_POOL_MMAP
+		static constexpr size_t huge_page_bytes = size_t(1) << 21;
 
-		template <class T>
-		T* get_tls() noexcept
+		inline size_t page_bytes() noexcept
 		{
-			return get_tls_pool<T>().get();
+			static const size_t bytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			return bytes;
 		}
 
-		template <class T>
-		void ret_tls(T* t) noexcept
+		// bytes and align are multiples of page, over-map and cut when align is bigger
+		inline void* map_aligned(size_t bytes, size_t align, size_t page, int flags) noexcept
 		{
-			get_tls_pool<T>().ret(t);
+			size_t len = (align > page) ? bytes + align : bytes;
+			void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+			if (p == MAP_FAILED) return nullptr;
+			if (align <= page) return p;
+
+			char* base = static_cast<char*>(p);
+			char* aligned = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(base), align));
+			if (aligned > base) munmap(base, aligned - base);
+			char* end = aligned + bytes;
+			if (end < base + len) munmap(end, base + len - end);
+			return aligned;
 		}
 
-		template <int size>
-		void warm_up_tls_pool(int cnt) noexcept
-		{
-			using T = Mem<size>;
-			get_tls_pool<T>(cnt);
-		}
+		class Reserve {
+		private:
+			char* base_ = nullptr;
+			size_t cap_ = 0;
+			std::atomic<size_t> used_{0};
 
-		template <int size>
-		Mem<size>* get_tls() noexcept
-		{
-			using T = Mem<size>;
-			return get_tls_pool<T>().get();
-		}
+		public:
+			// address space only, pages are committed on first touch
+			explicit Reserve(size_t bytes, bool huge = true) noexcept
+			{
+				size_t unit = huge ? huge_page_bytes : page_bytes();
+				cap_ = round_up(bytes, unit);
+				base_ = static_cast<char*>(map_aligned(cap_, unit, page_bytes(), MAP_NORESERVE));
+				if (!base_) {
+					cap_ = 0;
+					return;
+				}
+#ifdef MADV_HUGEPAGE
+				if (huge) madvise(base_, cap_, MADV_HUGEPAGE);
+#endif
+			}
 
+			~Reserve() noexcept
+			{
+				if (base_) munmap(base_, cap_);
+			}
 
-		/*******************************************
-		 * singleton pool
-		 *******************************************/
-		template <class T>
-		Pool<T>& get_singleton_pool(int cnt = 0) noexcept
-		{
-			static Pool<T> pool(cnt);
-			return pool;
-		}
+			Reserve(const Reserve&) = delete;
+			Reserve& operator=(const Reserve&) = delete;
 
-		template <class T>
-		std::mutex& get_singleton_mutex() noexcept
-		{
-			static std::mutex mutex;
-			return mutex;
-		}
+			void* alloc(size_t bytes, size_t align) noexcept
+			{
+				size_t used = used_.load(std::memory_order_relaxed);
+				for (;;) {
+					size_t offset = round_up(used, align);
+					if (offset + bytes > cap_) return nullptr;
+					if (used_.compare_exchange_weak(used, offset + bytes, std::memory_order_relaxed)) {
+						return base_ + offset;
+					}
+				}
+			}
 
-		template <class T>
-		void warm_up_singleton(int cnt) noexcept
-		{
-			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
-			get_singleton_pool<T>(cnt);
-		}
+			// the pages go back to the os, the address range is not reused
+			void release(void* p, size_t bytes) noexcept
+			{
+				char* first = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(p), page_bytes()));
+				char* last = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + bytes) / page_bytes() * page_bytes());
+				if (first < last) madvise(first, last - first, MADV_DONTNEED);
+			}
 
-		template <class T>
-		T* get_singleton() noexcept
-		{
-			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
-			return get_singleton_pool<T>().get();
-		}
+			size_t capacity() const noexcept
+			{
+				return cap_;
+			}
 
-		template <class T>
-		void ret_singleton(T* t) noexcept
+			size_t used() const noexcept
+			{
+				return used_.load(std::memory_order_relaxed);
+			}
+		};
+#endif
+
+		// nodes from /sys, 1 when unknown or not linux
+		inline int numa_node_cnt() noexcept
 		{
-			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
-			get_singleton_pool<T>().ret(t);
+#ifdef VAN_POOL_NUMA
+			static const int cnt = []() {
+				int last = 0;
+				FILE* f = fopen("/sys/devices/system/node/possible", "r");
+				if (f) {
+					int first = 0;
+					int n = fscanf(f, "%d-%d", &first, &last);
+					if (n < 2) last = (n == 1) ? first : 0;
+					fclose(f);
+				}
+				return (last >= 0) ? last + 1 : 1;
+			}();
+			return cnt;
+#else
+			return 1;
+#endif
 		}
 
-		template <int size>
-		void warm_up_singleton(int cnt) noexcept
+#ifdef VAN_POOL_NUMA
+		// cpu to node from each node's cpulist ("0-3,8-11")
+		inline const std::vector<int>& numa_cpu_nodes() noexcept
 		{
-			using T = Mem<size>;
-			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
-			get_singleton_pool<T>(cnt);
+			static const std::vector<int> nodes = []() {
+				std::vector<int> v;
+				for (int node=0; node<numa_node_cnt(); ++node) {
+					char path[64];
+					snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+					FILE* f = fopen(path, "r");
+					if (!f) continue;
+
+					int first = 0;
+					while (fscanf(f, "%d", &first) == 1) {
+						int last = first;
+						int c = fgetc(f);
+						if (c == '-') {
+							if (fscanf(f, "%d", &last) != 1) break;
+							c = fgetc(f);
+						}
+						if (last >= static_cast<int>(v.size())) v.resize(last + 1, 0);
+						for (int cpu=first; cpu<=last; ++cpu) v[cpu] = node;
+						if (c != ',') break;
+					}
+					fclose(f);
+				}
+				return v;
+			}();
+			return nodes;
 		}
+#endif
 
-		template <int size>
-		Mem<size>* get_singleton() noexcept
+		// node of the calling thread's cpu, 0 when unknown
+		// sched_getcpu is served by rseq or the vdso, no syscall on the hot path
+		inline int numa_node() noexcept
 		{
-			using T = Mem<size>;
-			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
-			return get_singleton_pool<T>().get();
+#ifdef VAN_POOL_NUMA
+			if (numa_node_cnt() == 1) return 0;
+
+			const std::vector<int>& nodes = numa_cpu_nodes();
+			int cpu = sched_getcpu();
+			return (cpu >= 0 && cpu < static_cast<int>(nodes.size())) ? nodes[cpu] : 0;
+#else
+			return 0;
+#endif
 		}
 
+		class Provider {
+		public:
+			using Alloc = void* (*)(void* ctx, size_t bytes, size_t align);
+			using Free = void (*)(void* ctx, void* p, size_t bytes);
 
-		/*******************************************
-		 * monitor
-		 *******************************************/
-		class Count {
-			public:
-				uint64_t total_ = 0;
-				uint64_t use_ = 0;
-				uint64_t pool_ = 0;
-		};
-
-		using Stat = std::unordered_map<std::type_index, Count>;
-
-
-		class Monitor : public IMonitor {
 		private:
-			std::mutex mutex_;
-			Pools pools_;
+			Alloc alloc_ = &heap_alloc;
+			Free free_ = &heap_free;
+			void* ctx_ = nullptr;
+			size_t unit_ = 1;
 
 		public:
-			Monitor() noexcept
+			Provider() = default;
+
+			static Provider heap() noexcept
 			{
-				Channel::inst().set(this);
+				return Provider();
 			}
 
-			~Monitor() noexcept
+			// unit : the granularity alloc rounds bytes up to, if any
+			static Provider custom(Alloc alloc, Free free, void* ctx = nullptr, size_t unit = 1) noexcept
 			{
-				Channel::inst().set(nullptr);
+				Provider pv;
+				pv.alloc_ = alloc;
+				pv.free_ = free;
+				pv.ctx_ = ctx;
+				pv.unit_ = (unit > 0) ? unit : 1;
+				return pv;
 			}
 
-			static Monitor& inst()
+#ifdef VAN_POOL_MMAP
+			static Provider mapped() noexcept
 			{
-				static Monitor inst;
-				return inst;
+				return custom(&mapped_alloc, &mapped_free, nullptr, page_bytes());
 			}
 
-			virtual void created(std::type_index& tidx, Pool<void>* pool) noexcept override
+			static Provider huge() noexcept
 			{
-				std::lock_guard<std::mutex> lock(mutex_);
-				pools_[tidx].insert(pool);
+				return custom(&huge_alloc, &huge_free, nullptr, huge_page_bytes);
 			}
 
-			virtual void deleted(std::type_index& tidx, Pool<void>* pool) noexcept override
+			static Provider reserved(Reserve& range) noexcept
 			{
-				std::lock_guard<std::mutex> lock(mutex_);
-				auto& poolset = pools_[tidx];
-				poolset.erase(pool);
-				if (poolset.empty()) {
-					pools_.erase(tidx);
-				}
+				return custom(&reserved_alloc, &reserved_free, &range);
 			}
-
-			Stat stat() noexcept
+#else
+			static Provider mapped() noexcept
 			{
-				std::lock_guard<std::mutex> lock(mutex_);
+				return Provider();
+			}
 
-				Stat stat;
-				for (auto it : pools_) {
-					auto& tidx = it.first;
-					auto& poolset = it.second;
+			static Provider huge() noexcept
+			{
+				return Provider();
+			}
+#endif
 
-					Count cnt;
-					for (auto* pool : poolset) {
-						cnt.total_ += pool->total_cnt();
-						cnt.use_ += pool->use_cnt();
-					}
-					cnt.pool_ = poolset.size();
-					stat[tidx] = cnt;
-				}
-				return stat;
+#ifdef VAN_POOL_NUMA
+			// node and page kind packed into the context
+			static Provider numa(int node, bool huge = false) noexcept
+			{
+				uintptr_t ctx = (static_cast<uintptr_t>(node) << 1) | (huge ? 1 : 0);
+				return custom(&numa_alloc, huge ? &huge_free : &mapped_free, reinterpret_cast<void*>(ctx), huge ? huge_page_bytes : page_bytes());
 			}
+#else
+			static Provider numa(int, bool = false) noexcept
+			{
+				return Provider();
+			}
+#endif
 
-		};
+#ifdef VAN_POOL_NUMA
+			// one node : nothing to bind, like NumaPool
+			static Provider numa_local(bool huge = false) noexcept
+			{
+				if (numa_node_cnt() == 1) return huge ? Provider::huge() : Provider();
+				return custom(&numa_local_alloc, huge ? &huge_free : &mapped_free, reinterpret_cast<void*>(static_cast<uintptr_t>(huge ? 1 : 0)), huge ? huge_page_bytes : page_bytes());
+			}
+#else
+			static Provider numa_local(bool = false) noexcept
+			{
+				return Provider();
+			}
+#endif
 
-		static void print_stat() noexcept
-		{
-			Stat s = Monitor::inst().stat();
+			void* alloc(size_t bytes, size_t align) const noexcept
+			{
+				return alloc_(ctx_, bytes, align);
+			}
 
-			printf(
-				"%4s %-30s %10s %10s %10s\n",
-				"NO.", "CLASS", "POOL", "TOTAL", "USE"
-			);
+			void free(void* p, size_t bytes) const noexcept
+			{
+				free_(ctx_, p, bytes);
+			}
+
+			size_t unit() const noexcept
+			{
+				return unit_;
+			}
+
+		private:
+			static void* heap_alloc(void*, size_t bytes, size_t align) noexcept
+			{
+				return aligned_malloc(bytes, align);
+			}
+
+			static void heap_free(void*, void* p, size_t) noexcept
+			{
+				aligned_free(p);
+			}
+
+#ifdef VAN_POOL_MMAP
+			static void* mapped_alloc(void*, size_t bytes, size_t align) noexcept
+			{
+				size_t page = page_bytes();
+				return map_aligned(round_up(bytes, page), round_up(align, page), page, 0);
+			}
+
+			static void mapped_free(void*, void* p, size_t bytes) noexcept
+			{
+				munmap(p, round_up(bytes, page_bytes()));
+			}
+
+			// both paths round to a huge page, so the free side needs no record of which one ran
+			static void* huge_alloc(void*, size_t bytes, size_t align) noexcept
+			{
+				bytes = round_up(bytes, huge_page_bytes);
+				align = round_up(align, huge_page_bytes);
+				void* p = nullptr;
+#ifdef MAP_HUGETLB
+				p = map_aligned(bytes, align, huge_page_bytes, MAP_HUGETLB);
+				if (p) return p;
+#endif
+				p = map_aligned(bytes, align, page_bytes(), 0);
+#ifdef MADV_HUGEPAGE
+				if (p) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+				return p;
+			}
+
+			static void huge_free(void*, void* p, size_t bytes) noexcept
+			{
+				munmap(p, round_up(bytes, huge_page_bytes));
+			}
+
+			static void* reserved_alloc(void* ctx, size_t bytes, size_t align) noexcept
+			{
+				return static_cast<Reserve*>(ctx)->alloc(bytes, align);
+			}
+
+			static void reserved_free(void* ctx, void* p, size_t bytes) noexcept
+			{
+				static_cast<Reserve*>(ctx)->release(p, bytes);
+			}
+#endif
+
+#ifdef VAN_POOL_NUMA
+			// preferred, not strict : a full node falls back to another one
+			static void* numa_alloc(void* ctx, size_t bytes, size_t align) noexcept
+			{
+				static const int mpol_preferred = 1;
+
+				uintptr_t packed = reinterpret_cast<uintptr_t>(ctx);
+				bool huge = (packed & 1) != 0;
+				unsigned long node = static_cast<unsigned long>(packed >> 1);
+
+				size_t page = huge ? huge_page_bytes : page_bytes();
+				bytes = round_up(bytes, page);
+				void* p = huge ? huge_alloc(nullptr, bytes, align) : mapped_alloc(nullptr, bytes, align);
+				if (!p || node >= sizeof(unsigned long) * 8) return p;
+
+				unsigned long mask = 1UL << node;
+				syscall(SYS_mbind, p, bytes, mpol_preferred, &mask, sizeof(mask) * 8, 0);
+				return p;
+			}
+
+			// ctx holds the page kind only, the node is the caller's at alloc time
+			static void* numa_local_alloc(void* ctx, size_t bytes, size_t align) noexcept
+			{
+				uintptr_t packed = (static_cast<uintptr_t>(numa_node()) << 1) | (reinterpret_cast<uintptr_t>(ctx) & 1);
+				return numa_alloc(reinterpret_cast<void*>(packed), bytes, align);
+			}
+#endif
+		};
+
+		/*******************************************
+		 * pool statistics
+		 *  - counts are objects, bytes are block bytes
+		 *  - rets_ is gets_ - use_, remote_rets_ counts returns from other threads
+		 *    once the owner reclaims them
+		 *  - fallbacks_ : blocks the provider failed to supply, taken from the heap
+		 *******************************************/
+		class PoolStat {
+		public:
+			uint64_t total_ = 0;
+			uint64_t use_ = 0;
+			uint64_t peak_ = 0;
+			uint64_t blocks_ = 0;
+			uint64_t grows_ = 0;
+			uint64_t reserved_bytes_ = 0;
+			uint64_t used_bytes_ = 0;
+			uint64_t gets_ = 0;
+			uint64_t rets_ = 0;
+			uint64_t remote_rets_ = 0;
+			uint64_t fallbacks_ = 0;
+		};
+
+
+		/*******************************************
+		 * pool base
+		 *  - the stats header of every Pool<T> : no virtuals, first base, so it sits
+		 *    at a fixed offset and Registry, Monitor and Trimmer read it without T
+		 *  - registers itself, so a walker only ever touches a live base
+		 *  - the blocks dead pools of T left behind have a base of their own (orphans),
+		 *    summed with the pools of T but not counted as one
+		 *******************************************/
+		class PoolBase {
+		protected:
+			std::atomic<uint64_t> total_cnt_{0};
+
+			// single writer, fast path : use is get - ret, one counter per call
+			std::atomic<uint64_t> get_cnt_{0};
+			std::atomic<uint64_t> ret_cnt_{0};
+			std::atomic<uint64_t> peak_cnt_{0};
+
+			// single writer, slow path
+			std::atomic<uint64_t> block_cnt_{0};
+			std::atomic<uint64_t> grow_cnt_{0};
+			std::atomic<uint64_t> reserved_{0};
+			std::atomic<uint64_t> remote_cnt_{0};
+			std::atomic<uint64_t> fallback_cnt_{0};
+
+			// sizeof(Pool<T>::Obj), readable without T
+			uint64_t obj_bytes_;
+
+			// concurrent writers (LockFreePool) count in padded stripes, summed on read
+			// enter_cnt_ : gets started, get_cnt_ counts them done, LockFreePool's trim
+			// waits for the two to meet (counted without VAN_POOL_STATS too)
+			struct alignas(64) Stripe {
+				std::atomic<uint64_t> get_cnt_;
+				std::atomic<uint64_t> ret_cnt_;
+				std::atomic<uint64_t> enter_cnt_;
+			};
+			static constexpr int stripe_cnt_ = 16;
+			std::atomic<Stripe*> stripes_{nullptr};		// set after registration, freed after deregistration
+
+			// odd while a slow path moves total and use together
+			std::atomic<uint32_t> stat_seq_{0};
+
+			// requested by any thread, applied by the owner when a block empties
+			// (LockFreePool : by the next ret)
+			static constexpr uint64_t no_trim_ = UINT64_MAX;
+			std::atomic<uint64_t> trim_to_{no_trim_};
+
+			Registry::Slot* slot_ = nullptr;
+			bool orphans_;
+
+		public:
+			PoolBase(const std::type_info& type, uint64_t obj_bytes, bool orphans = false) noexcept
+				: obj_bytes_(obj_bytes), orphans_(orphans)
+			{
+				slot_ = Registry::inst().created(this, type);
+			}
+
+			// runs after ~Pool<T>, walkers are out before the header goes
+			~PoolBase() noexcept
+			{
+				Registry::inst().deleted(slot_);
+
+				if (stripes_.load(std::memory_order_relaxed)) {
+					aligned_free(stripes_.load(std::memory_order_relaxed));
+				}
+			}
+
+			PoolBase(const PoolBase&) = delete;
+			PoolBase& operator=(const PoolBase&) = delete;
+
+			// any thread : the owner shrinks on its next return that empties a block,
+			// LockFreePool on its next return
+			void request_trim(uint64_t bytes = 0) noexcept
+			{
+				trim_to_.store(bytes, std::memory_order_relaxed);
+			}
+
+			uint64_t reserved_bytes() noexcept
+			{
+				return reserved_.load(std::memory_order_relaxed);
+			}
+
+			bool orphans() const noexcept
+			{
+				return orphans_;
+			}
+
+
+			uint64_t total_cnt() noexcept
+			{
+				return total_cnt_.load(std::memory_order_relaxed);
+			}
+
+			// objects returned by other threads count as used until reclaimed
+			// rets first : a later get read against an older ret only overstates use
+			uint64_t use_cnt() noexcept
+			{
+				uint64_t rets = ret_cnt();
+				uint64_t gets = get_cnt();
+				return (gets > rets) ? gets - rets : 0;
+			}
+
+			uint64_t get_cnt() noexcept
+			{
+				uint64_t cnt = get_cnt_.load(std::memory_order_acquire);
+#if VAN_POOL_STATS
+				Stripe* stripes = stripes_.load(std::memory_order_acquire);
+				if (stripes) {
+					for (int i=0; i<stripe_cnt_; ++i) {
+						cnt += stripes[i].get_cnt_.load(std::memory_order_acquire);
+					}
+				}
+#endif
+				return cnt;
+			}
+
+			uint64_t ret_cnt() noexcept
+			{
+				uint64_t cnt = ret_cnt_.load(std::memory_order_acquire);
+				Stripe* stripes = stripes_.load(std::memory_order_acquire);
+				if (stripes) {
+					for (int i=0; i<stripe_cnt_; ++i) {
+						cnt += stripes[i].ret_cnt_.load(std::memory_order_acquire);
+					}
+				}
+				return cnt;
+			}
+
+			// one consistent set for a reader on another thread, use never above total
+			// striped pools have no owner to track the peak, the readers sample it
+			void snapshot(PoolStat& st) noexcept
+			{
+				uint32_t seq;
+				do {
+					seq = stat_seq_.load(std::memory_order_acquire);
+					st.total_ = total_cnt_.load(std::memory_order_relaxed);
+					st.blocks_ = block_cnt_.load(std::memory_order_relaxed);
+					st.reserved_bytes_ = reserved_.load(std::memory_order_relaxed);
+					uint64_t rets = ret_cnt();
+					st.gets_ = get_cnt();
+					st.use_ = (st.gets_ > rets) ? st.gets_ - rets : 0;
+					std::atomic_thread_fence(std::memory_order_acquire);
+				} while ((seq & 1) || seq != stat_seq_.load(std::memory_order_relaxed));
+
+				if (st.use_ > st.total_) st.use_ = st.total_;
+				st.rets_ = (st.gets_ > st.use_) ? st.gets_ - st.use_ : 0;
+				st.used_bytes_ = st.use_ * obj_bytes_;
+				st.grows_ = grow_cnt_.load(std::memory_order_relaxed);
+				st.remote_rets_ = remote_cnt_.load(std::memory_order_relaxed);
+				st.fallbacks_ = fallback_cnt_.load(std::memory_order_relaxed);
+
+				uint64_t peak = peak_cnt_.load(std::memory_order_relaxed);
+				if (stripes_.load(std::memory_order_relaxed)) {
+					while (peak < st.use_ && !peak_cnt_.compare_exchange_weak(peak, st.use_, std::memory_order_relaxed)) {
+					}
+					if (peak < st.use_) peak = st.use_;
+				}
+				st.peak_ = (peak > st.use_) ? peak : st.use_;
+			}
+
+		protected:
+			// single writer : plain load/store, no locked instruction on the fast path
+			static void add(std::atomic<uint64_t>& cnt, uint64_t n) noexcept
+			{
+				cnt.store(cnt.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+			}
+
+			static void sub(std::atomic<uint64_t>& cnt, uint64_t n) noexcept
+			{
+				cnt.store(cnt.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+			}
+
+			void count_get(uint64_t n) noexcept
+			{
+#if VAN_POOL_STATS
+				uint64_t gets = get_cnt_.load(std::memory_order_relaxed) + n;
+				get_cnt_.store(gets, std::memory_order_release);
+
+				uint64_t use = gets - ret_cnt_.load(std::memory_order_relaxed);
+				if (use > peak_cnt_.load(std::memory_order_relaxed)) {
+					peak_cnt_.store(use, std::memory_order_relaxed);
+				}
+#else
+				(void)n;
+#endif
+			}
+
+			void count_ret(uint64_t n) noexcept
+			{
+#if VAN_POOL_STATS
+				ret_cnt_.store(ret_cnt_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+#else
+				(void)n;
+#endif
+			}
+
+			// objects still live in an adopted block : used, but never got from this pool
+			void count_adopted(uint64_t n) noexcept
+			{
+#if VAN_POOL_STATS
+				get_cnt_.store(get_cnt_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+#else
+				(void)n;
+#endif
+			}
+
+			// seqlock write side, slow paths only
+			void begin_stat() noexcept
+			{
+				stat_seq_.store(stat_seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+			}
+
+			void end_stat() noexcept
+			{
+				stat_seq_.store(stat_seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			}
+
+			static int stripe_of_thread() noexcept
+			{
+				static std::atomic<int> next{0};
+				thread_local int idx = next.fetch_add(1, std::memory_order_relaxed) % stripe_cnt_;
+				return idx;
+			}
+		};
+
+
+		template <class T>
+		class Pool : public PoolBase {
+		protected:
+
+			struct Block;
+
+			// free : next_ overlays the object, in use : inst_
+			// default layout : block_ never changes, so any thread can find the owning block
+			static constexpr size_t align_ = (PoolAlign<T>::value > alignof(void*)) ? PoolAlign<T>::value : alignof(void*);
+			static constexpr bool hardened_ = PoolCheck<T>::hardened;
+			static constexpr bool compact_ = PoolLayout<T>::compact && !hardened_;
+
+			struct alignas(align_) FullObj {
+				union {
+					T inst_;
+					FullObj* next_;
+				};
+				Block* block_;
+			};
+
+			struct alignas(align_) CompactObj {
+				union {
+					T inst_;
+					CompactObj* next_;
+				};
+			};
+
+			// hardened : canary_ is mask(obj) while live, ~mask(obj) ^ the stored link while free
+			struct alignas(align_) CheckedObj {
+				union {
+					T inst_;
+					CheckedObj* next_;
+				};
+				uintptr_t canary_;				// first word an overrun reaches
+				Block* block_;
+			};
+
+			using Obj = typename std::conditional<hardened_, CheckedObj, typename std::conditional<compact_, CompactObj, FullObj>::type>::type;
+			Obj* curr_ = nullptr;
+			Obj* last_ = nullptr;
+			Obj* free_ = nullptr;
+
+			// remote returns raise pending_ so the owner scans its blocks only when needed
+			// type-stable : recycled but never freed, a stale pointer costs one extra scan
+			struct Inbox {
+				Inbox* next_;
+				std::atomic<bool> pending_;
+			};
+			Inbox* inbox_ = nullptr;
+
+			struct Block {
+				Block* next_;
+				std::atomic<Pool<T>*> owner_;		// nullptr while abandoned
+				std::atomic<Inbox*> inbox_;			// owner's inbox, nullptr while abandoned
+				std::atomic<Obj*> remote_;			// returned by other threads
+				std::atomic<int> pushers_;			// remote returns still reading the header
+				Block* prev_;						// while abandoned, Shared unlinks it when it empties
+				Obj* free_;							// free objects while abandoned
+				uint64_t live_;						// owner only
+				int cnt_;
+				uint64_t bytes_;					// as allocated, cnt_ objects may leave a tail
+				Provider provider_;					// released through the one that allocated it
+			};
+			Block* blocks_ = nullptr;
+			Block* bump_ = nullptr;
+
+			// shared by every pool of T : blocks of dead pools with live objects, free inboxes
+			// an abandoned block is freed by the remote ret that brings back its last object
+			struct Shared : public PoolBase {
+				std::mutex mutex_;
+				Block* blocks_ = nullptr;
+				std::atomic<uint64_t> cnt_{0};
+				Inbox* inboxes_ = nullptr;
+
+				Shared() noexcept
+					: PoolBase(typeid(T), sizeof(Obj), true)
+				{
+#if VAN_POOL_VALGRIND
+					// one mempool per type : objects move between pools of T
+					VALGRIND_CREATE_MEMPOOL(this, 0, 0);
+#endif
+				}
+
+				~Shared() noexcept
+				{
+					Block* block = blocks_;
+					while (block) {
+						Block* next = block->next_;
+						free_block(block);
+						block = next;
+					}
+
+					Inbox* inbox = inboxes_;
+					while (inbox) {
+						Inbox* next = inbox->next_;
+						delete inbox;
+						inbox = next;
+					}
+#if VAN_POOL_VALGRIND
+					VALGRIND_DESTROY_MEMPOOL(this);
+#endif
+				}
+
+				// returns the block when its last live object already came back, the caller frees it
+				Block* abandon(Block* block) noexcept
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+
+					block->owner_.store(nullptr, std::memory_order_release);
+					block->inbox_.store(nullptr, std::memory_order_seq_cst);
+					link(block);
+
+					begin_stat();
+					add(total_cnt_, block->cnt_);
+					add(block_cnt_, 1);
+					add(reserved_, block->bytes_);
+					count_adopted(block->live_);
+					end_stat();
+					return collect_locked(block);
+				}
+
+				// the first abandoned block, owned by pool from here on
+				Block* adopt(Pool<T>* pool, Inbox* inbox) noexcept
+				{
+					if (cnt_.load(std::memory_order_relaxed) == 0) return nullptr;
+
+					std::lock_guard<std::mutex> lock(mutex_);
+					Block* block = blocks_;
+					if (!block) return nullptr;
+
+					unlink(block);
+					block->owner_.store(pool, std::memory_order_release);
+					block->inbox_.store(inbox, std::memory_order_seq_cst);
+
+					begin_stat();
+					sub(total_cnt_, block->cnt_);
+					sub(block_cnt_, 1);
+					sub(reserved_, block->bytes_);
+					count_ret(block->live_);
+					end_stat();
+					return block;
+				}
+
+				// a remote ret into a block that had no inbox, the caller still pins it
+				Block* collect(Block* block) noexcept
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (block->owner_.load(std::memory_order_relaxed)) return nullptr;		// adopted meanwhile
+					return collect_locked(block);
+				}
+
+			private:
+				// remote returns go to the block's own free list
+				// only the call that brings live_ to 0 unlinks the block, a later one finds nothing
+				Block* collect_locked(Block* block) noexcept
+				{
+					uint64_t n = 0;
+					Obj* obj = block->remote_.exchange(nullptr, std::memory_order_seq_cst);
+					while (obj) {
+						Obj* next = next_of(obj);
+						set_next(obj, block->free_);
+						block->free_ = obj;
+						obj = next;
+						++n;
+					}
+					if (n == 0) return nullptr;
+
+					block->live_ -= n;
+					begin_stat();
+					count_ret(n);
+					if (block->live_ == 0) {
+						unlink(block);
+						sub(total_cnt_, block->cnt_);
+						sub(block_cnt_, 1);
+						sub(reserved_, block->bytes_);
+					}
+					end_stat();
+					return (block->live_ == 0) ? block : nullptr;
+				}
+
+				void link(Block* block) noexcept
+				{
+					block->prev_ = nullptr;
+					block->next_ = blocks_;
+					if (blocks_) blocks_->prev_ = block;
+					blocks_ = block;
+					cnt_.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				void unlink(Block* block) noexcept
+				{
+					if (block->prev_) {
+						block->prev_->next_ = block->next_;
+					} else {
+						blocks_ = block->next_;
+					}
+					if (block->next_) block->next_->prev_ = block->prev_;
+					cnt_.fetch_sub(1, std::memory_order_relaxed);
+				}
+			};
+
+			int cnt_ = 128;			// objects in the next block
+			Growth growth_;
+			Provider provider_;
+
+		public:
+			using value_type = T;
+
+		public:
+
+			Pool(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+				: PoolBase(typeid(T), sizeof(Obj)), growth_(growth), provider_(provider)
+			{
+				// constructed before any pool, so it is destroyed after all of them
+				inbox_ = alloc_inbox();
+
+				if (cnt > 0) {
+					cnt_ = cnt;
+					new_block();
+				}
+			}
+
+			~Pool() noexcept
+			{
+				reclaim();
+
+				// hand every free object back to its block
+				while (free_) {
+					Obj* obj = free_;
+					free_ = next_of(obj);
+					set_next(obj, block_of(obj)->free_);
+					block_of(obj)->free_ = obj;
+				}
+				for (; curr_ < last_; ++curr_) {
+					annotate_carve(curr_);
+					set_block(curr_, bump_);
+					poison(curr_);
+					set_next(curr_, bump_->free_);
+					annotate_free(curr_);
+					bump_->free_ = curr_;
+				}
+
+				Block* block = blocks_;
+				while (block) {
+					Block* next = block->next_;
+					if (block->live_ != 0) {
+						block = shared().abandon(block);
+					}
+					if (block) free_block(block);
+					block = next;
+				}
+
+				free_inbox(inbox_);
+			}
+
+			Pool(const Pool<T>&) = delete;
+			Pool& operator=(const Pool<T>&) = delete;
+
+			T* get() noexcept
+			{
+				Obj* obj = pop_free();
+				count_get(1);
+				return &(obj->inst_);
+			}
+
+			// objects of another pool go to their block's remote queue
+			void ret(T* t) noexcept
+			{
+				Obj* obj = reinterpret_cast<Obj*>(t);
+				if (!check_ret(obj)) return;
+				annotate_ret(obj);
+
+				Block* block = block_of(obj);
+				if (block->owner_.load(std::memory_order_acquire) != this) {
+					ret_remote(obj);
+					return;
+				}
+
+				count_ret(1);
+				push_free(obj, block);
+
+				if (block->live_ == 0 && trim_to_.load(std::memory_order_relaxed) != no_trim_) {
+					shrink_to(trim_to_.load(std::memory_order_relaxed));
+				}
+			}
+
+			// the counters and the trim check are paid once per batch
+			void get_n(T** out, size_t n) noexcept
+			{
+				for (size_t i=0; i<n; ++i) {
+					out[i] = &(pop_free()->inst_);
+				}
+				count_get(n);
+			}
+
+			void ret_n(T** in, size_t n) noexcept
+			{
+				uint64_t local = 0;
+				bool drained = false;
+				for (size_t i=0; i<n; ++i) {
+					Obj* obj = reinterpret_cast<Obj*>(in[i]);
+					if (!check_ret(obj)) continue;
+					annotate_ret(obj);
+
+					Block* block = block_of(obj);
+					if (block->owner_.load(std::memory_order_acquire) != this) {
+						ret_remote(obj);
+						continue;
+					}
+
+					++local;
+					push_free(obj, block);
+					drained |= (block->live_ == 0);
+				}
+				count_ret(local);
+
+				if (drained && trim_to_.load(std::memory_order_relaxed) != no_trim_) {
+					shrink_to(trim_to_.load(std::memory_order_relaxed));
+				}
+			}
+
+			// release blocks without live objects until at most bytes are reserved
+			// owner only, returns the released bytes
+			uint64_t shrink_to(uint64_t bytes) noexcept
+			{
+				trim_to_.store(no_trim_, std::memory_order_relaxed);
+				reclaim();
+
+				// released blocks are marked by a null owner, nobody can push to them
+				uint64_t reserved = reserved_.load(std::memory_order_relaxed);
+				uint64_t released = 0;
+				for (Block* block = blocks_; block && reserved > bytes; block = block->next_) {
+					if (block->live_ == 0) {
+						block->owner_.store(nullptr, std::memory_order_relaxed);
+						reserved -= block->bytes_;
+						released += block->bytes_;
+					}
+				}
+				if (released == 0) return 0;
+
+				Obj* prev = nullptr;
+				for (Obj* obj = free_; obj; ) {
+					Obj* next = next_of(obj);
+					if (block_of(obj)->owner_.load(std::memory_order_relaxed)) {
+						prev = obj;
+					} else if (prev) {
+						set_next(prev, next);
+					} else {
+						free_ = next;
+					}
+					obj = next;
+				}
+
+				if (bump_ && !bump_->owner_.load(std::memory_order_relaxed)) {
+					bump_ = nullptr;
+					curr_ = nullptr;
+					last_ = nullptr;
+				}
+
+				begin_stat();
+				Block** blink = &blocks_;
+				while (*blink) {
+					Block* block = *blink;
+					if (!block->owner_.load(std::memory_order_relaxed)) {
+						*blink = block->next_;
+						sub(total_cnt_, block->cnt_);
+						sub(block_cnt_, 1);
+						sub(reserved_, block->bytes_);
+						free_block(block);
+					} else {
+						blink = &block->next_;
+					}
+				}
+				end_stat();
+				return released;
+			}
+
+			uint64_t trim() noexcept
+			{
+				return shrink_to(0);
+			}
+
+		protected:
+
+			// header padded so the first object keeps the object alignment
+			static constexpr uint64_t header_bytes() noexcept
+			{
+				return (sizeof(Block) + alignof(Obj) - 1) / alignof(Obj) * alignof(Obj);
+			}
+
+			static uint64_t block_bytes(int cnt) noexcept
+			{
+				return header_bytes() + (sizeof(Obj) * static_cast<uint64_t>(cnt));
+			}
+
+			static constexpr uint64_t pow2(uint64_t n, uint64_t p = 1) noexcept
+			{
+				return (p >= n) ? p : pow2(n, p * 2);
+			}
+
+			// compact layout : block size and alignment, big enough for one object
+			static constexpr uint64_t span() noexcept
+			{
+				return pow2((PoolLayout<T>::span > header_bytes() + sizeof(Obj)) ? PoolLayout<T>::span : header_bytes() + sizeof(Obj));
+			}
+
+			static Block* block_of(FullObj* obj) noexcept
+			{
+				return load_word(&obj->block_);
+			}
+
+			static Block* block_of(CompactObj* obj) noexcept
+			{
+				return reinterpret_cast<Block*>(reinterpret_cast<uintptr_t>(obj) & ~static_cast<uintptr_t>(span() - 1));
+			}
+
+			static void set_block(FullObj* obj, Block* block) noexcept
+			{
+				store_word(&obj->block_, block);
+			}
+
+			static void set_block(CompactObj*, Block*) noexcept
+			{
+			}
+
+			static Block* block_of(CheckedObj* obj) noexcept
+			{
+				return load_word(&obj->block_);
+			}
+
+			static void set_block(CheckedObj* obj, Block* block) noexcept
+			{
+				store_word(&obj->block_, block);
+			}
+
+			// free list links, encoded when hardened
+			// a free object's link is poisoned, next_of and set_next open it around the access
+			static Obj* next_of(Obj* obj) noexcept
+			{
+				bool closed = expose(obj, sizeof(void*));
+				Obj* next = link_of(obj);
+				if (closed) conceal(obj, sizeof(void*));
+				return next;
+			}
+
+			static void set_next(Obj* obj, Obj* next) noexcept
+			{
+				bool closed = expose(obj, sizeof(void*));
+				set_link(obj, next);
+				if (closed) conceal(obj, sizeof(void*));
+			}
+
+			// the link must be addressable : LockFreePool keeps it open, pop_free opens it
+			static Obj* link_of(Obj* obj) noexcept
+			{
+				return decode(obj, relaxed_load(&obj->next_));
+			}
+
+			// stored : the link word as read
+			static Obj* decode(Obj* obj, Obj* stored) noexcept
+			{
+				if (!hardened_) return stored;
+				return reinterpret_cast<Obj*>(reinterpret_cast<uintptr_t>(stored) ^ Hardened::mask(obj));
+			}
+
+			static void set_link(Obj* obj, Obj* next) noexcept
+			{
+				if (!hardened_) {
+					relaxed_store(&obj->next_, next);
+					return;
+				}
+				relaxed_store(&obj->next_, reinterpret_cast<Obj*>(reinterpret_cast<uintptr_t>(next) ^ Hardened::mask(obj)));
+				set_free(obj);
+			}
+
+			// demangled once, for fault reports
+			static const char* type_name() noexcept
+			{
+				static const std::string name = demangle(typeid(T).name());
+				return name.c_str();
+			}
+
+			// LockFreePool reads the link of a top another thread may pop and push
+			// again meanwhile : relaxed atomics, plain moves on x86 and arm
+			template <class W>
+			static W relaxed_load(const W* p) noexcept
+			{
+#if defined(__GNUC__)
+				return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+				return *static_cast<const volatile W*>(p);
+#endif
+			}
+
+			template <class W>
+			static void relaxed_store(W* p, W w) noexcept
+			{
+#if defined(__GNUC__)
+				__atomic_store_n(p, w, __ATOMIC_RELAXED);
+#else
+				*static_cast<volatile W*>(p) = w;
+#endif
+			}
+
+			/***** hardened checks, no-ops on the other layouts *****/
+			// stored : the link word as stored, the canary of a free object is bound to it
+			static uintptr_t free_canary(CheckedObj* obj, CheckedObj* stored) noexcept
+			{
+				return ~Hardened::mask(obj) ^ reinterpret_cast<uintptr_t>(stored);
+			}
+
+			static void set_free(CheckedObj* obj) noexcept
+			{
+				store_word(&obj->canary_, free_canary(obj, relaxed_load(&obj->next_)));
+			}
+
+			static void set_free(void*) noexcept
+			{
+			}
+
+			static void set_live(CheckedObj* obj) noexcept
+			{
+				store_word(&obj->canary_, Hardened::mask(obj));
+			}
+
+			static void set_live(void*) noexcept
+			{
+			}
+
+			// false : the link was overwritten, the rest of the list is not trusted
+			// the link must be addressable, as for link_of
+			static bool check_link(CheckedObj* obj) noexcept
+			{
+				if (load_word(&obj->canary_) != free_canary(obj, relaxed_load(&obj->next_))) {
+					Hardened::fault(Hardened::Fault::bad_link, type_name(), obj);
+					return false;
+				}
+				return true;
+			}
+
+			static bool check_link(void*) noexcept
+			{
+				return true;
+			}
+
+			// check_link without the report, for an object another thread may have popped
+			static bool link_ok(CheckedObj* obj, CheckedObj* stored) noexcept
+			{
+				return peek_word(&obj->canary_) == free_canary(obj, stored);
+			}
+
+			static bool link_ok(void*, void*) noexcept
+			{
+				return true;
+			}
+
+			// a write after ret into the poison is reported, the object is still handed out
+			static void check_poison(CheckedObj* obj) noexcept
+			{
+				// no early exit, so the scan vectorizes
+				const unsigned char* p = reinterpret_cast<const unsigned char*>(obj);
+				unsigned char diff = 0;
+				for (size_t i=sizeof(void*); i<sizeof(T); ++i) {
+					diff |= p[i] ^ Hardened::poison_;
+				}
+				if (diff) {
+					Hardened::fault(Hardened::Fault::use_after_ret, type_name(), obj);
+				}
+			}
+
+			static void check_poison(void*) noexcept
+			{
+			}
+
+			// false : not a live object of T, the caller drops it
+			// the canary is only consulted for the kind of fault, a free one is a double ret
+			// blocks_mutex : taken on the fault path when the caller is not the only writer of blocks_
+			bool check_ret(CheckedObj* obj, std::mutex* blocks_mutex = nullptr) noexcept
+			{
+				uintptr_t canary = load_word(&obj->canary_);
+				if (canary != Hardened::mask(obj)) {
+					Hardened::Fault fault = Hardened::Fault::foreign;
+					if (canary == free_canary(obj, load_word(&obj->next_))) {
+						fault = Hardened::Fault::double_ret;
+					} else if (owns(obj, blocks_mutex)) {
+						fault = Hardened::Fault::overflow;
+					}
+					Hardened::fault(fault, type_name(), obj);
+					return false;
+				}
+				if (!in_block(obj, block_of(obj))) {
+					Hardened::fault(Hardened::Fault::foreign, type_name(), obj);
+					return false;
+				}
+
+				poison(obj);
+				return true;
+			}
+
+			// asan : a free object is poisoned from its first byte, in LockFreePool past its link
+			// word, a live one is addressable up to sizeof(T)
+			bool check_ret(void* obj, std::mutex* = nullptr) noexcept
+			{
+#ifdef VAN_POOL_ASAN
+				char* p = static_cast<char*>(obj);
+				if (__asan_address_is_poisoned(p) || (sizeof(T) > sizeof(void*) && __asan_address_is_poisoned(p + sizeof(void*)))) {
+					Hardened::fault(Hardened::Fault::double_ret, type_name(), obj);
+					return false;
+				}
+#else
+				(void)obj;
+#endif
+				return true;
+			}
+
+			// past the link word, checked by check_poison
+			static void poison(CheckedObj* obj) noexcept
+			{
+				if (sizeof(T) > sizeof(void*)) {
+					memset(reinterpret_cast<char*>(obj) + sizeof(void*), Hardened::poison_, sizeof(T) - sizeof(void*));
+				}
+			}
+
+			static void poison(void*) noexcept
+			{
+			}
+
+			// an object boundary inside the block
+			static bool in_block(Obj* obj, Block* block) noexcept
+			{
+				uintptr_t first = reinterpret_cast<uintptr_t>(block) + header_bytes();
+				uintptr_t at = reinterpret_cast<uintptr_t>(obj);
+				return at >= first && (at - first) % sizeof(Obj) == 0 && (at - first) / sizeof(Obj) < static_cast<uintptr_t>(block->cnt_);
+			}
+
+			// blocks_ has one writer : the owner, or whoever holds blocks_mutex
+			bool owns(Obj* obj, std::mutex* blocks_mutex) noexcept
+			{
+				std::unique_lock<std::mutex> lock;
+				if (blocks_mutex) {
+					lock = std::unique_lock<std::mutex>(*blocks_mutex);
+				}
+
+				for (Block* block = blocks_; block; block = block->next_) {
+					if (in_block(obj, block)) return true;
+				}
+				return false;
+			}
+
+			/***** sanitizer annotations, no-ops unless built with asan or VAN_POOL_VALGRIND *****/
+			// free : the whole object and the words after it are poisoned
+			// live : T is addressable, the words after it (block_, canary_) stay poisoned
+			// the pool opens its own words around each access, see load_word and next_of
+			// keep_link : LockFreePool reads the link of a popped object racily, so
+			// its link word stays addressable, free or live
+
+			// true : it was poisoned and the caller closes it again
+			// asan leaves addressable memory as found, a foreign pointer is not poisoned
+			static bool expose(const void* p, size_t bytes) noexcept
+			{
+#ifdef VAN_POOL_ASAN
+				if (!__asan_region_is_poisoned(const_cast<void*>(p), bytes)) return false;
+				ASAN_UNPOISON_MEMORY_REGION(p, bytes);
+				return true;
+#elif VAN_POOL_VALGRIND
+				VALGRIND_MAKE_MEM_DEFINED(p, bytes);
+				return true;
+#else
+				(void)p;
+				(void)bytes;
+				return false;
+#endif
+			}
+
+			static void conceal(const void* p, size_t bytes) noexcept
+			{
+#ifdef VAN_POOL_ASAN
+				ASAN_POISON_MEMORY_REGION(p, bytes);
+#endif
+#if VAN_POOL_VALGRIND
+				VALGRIND_MAKE_MEM_NOACCESS(p, bytes);
+#endif
+				(void)p;
+				(void)bytes;
+			}
+
+			// relaxed : LockFreePool peeks at the canary of an object another thread popped
+			template <class W>
+			static W load_word(const W* p) noexcept
+			{
+				bool closed = expose(p, sizeof(W));
+				W w = relaxed_load(p);
+				if (closed) conceal(p, sizeof(W));
+				return w;
+			}
+
+			template <class W>
+			static void store_word(W* p, W w) noexcept
+			{
+				bool closed = expose(p, sizeof(W));
+				relaxed_store(p, w);
+				if (closed) conceal(p, sizeof(W));
+			}
+
+			// a word of an object another thread may be opening or closing : read as is,
+			// the shadow is left alone
+			template <class W>
+			VAN_POOL_NO_ASAN static W peek_word(const W* p) noexcept
+			{
+#if VAN_POOL_VALGRIND
+				VALGRIND_DISABLE_ERROR_REPORTING;
+#endif
+				// not relaxed_load : a call out of here would be instrumented
+#if defined(__GNUC__)
+				W w = __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+				W w = *static_cast<const volatile W*>(p);
+#endif
+#if VAN_POOL_VALGRIND
+				VALGRIND_ENABLE_ERROR_REPORTING;
+#endif
+				return w;
+			}
+
+			// objects of a new block are not addressable until carved
+			static void annotate_block(Obj* first, int cnt) noexcept
+			{
+#ifdef VAN_POOL_ASAN
+				ASAN_POISON_MEMORY_REGION(first, sizeof(Obj) * cnt);
+#endif
+#if VAN_POOL_VALGRIND
+				VALGRIND_MAKE_MEM_NOACCESS(first, sizeof(Obj) * cnt);
+#endif
+				(void)first;
+				(void)cnt;
+			}
+
+			// back to the provider fully addressable, it may hand the range out again
+			static void annotate_release(Block* block, uint64_t bytes) noexcept
+			{
+#ifdef VAN_POOL_ASAN
+				ASAN_UNPOISON_MEMORY_REGION(block, bytes);
+#endif
+#if VAN_POOL_VALGRIND
+				VALGRIND_MAKE_MEM_UNDEFINED(block, bytes);
+#endif
+				(void)block;
+				(void)bytes;
+			}
+
+			// bump object : addressable for the pool to set it up
+			static void annotate_carve(Obj* obj) noexcept
+			{
+#ifdef VAN_POOL_ASAN
+				ASAN_UNPOISON_MEMORY_REGION(obj, sizeof(Obj));
+#endif
+#if VAN_POOL_VALGRIND
+				VALGRIND_MAKE_MEM_UNDEFINED(obj, sizeof(Obj));
+#endif
+				(void)obj;
+			}
+
+			static void annotate_free(Obj* obj, bool keep_link = false) noexcept
+			{
+				size_t first = keep_link ? sizeof(void*) : 0;
+				conceal(reinterpret_cast<char*>(obj) + first, sizeof(Obj) - first);
+			}
+
+			// the tail is closed before T is opened, a kept link is never closed in between
+			static void annotate_get(Obj* obj, bool keep_link = false) noexcept
+			{
+				size_t first = (keep_link && sizeof(T) < sizeof(void*)) ? sizeof(void*) : sizeof(T);
+#ifdef VAN_POOL_ASAN
+				ASAN_POISON_MEMORY_REGION(reinterpret_cast<char*>(obj) + first, sizeof(Obj) - first);
+				ASAN_UNPOISON_MEMORY_REGION(obj, sizeof(T));
+#endif
+#if VAN_POOL_VALGRIND
+				VALGRIND_MAKE_MEM_NOACCESS(reinterpret_cast<char*>(obj) + first, sizeof(Obj) - first);
+				VALGRIND_MEMPOOL_ALLOC(&shared(), obj, sizeof(T));
+				if (hardened_) {
+					VALGRIND_MAKE_MEM_DEFINED(obj, sizeof(T));		// the poison check reads it
+				}
+#endif
+				(void)obj;
+				(void)first;
+			}
+
+			static void annotate_ret(Obj* obj, bool keep_link = false) noexcept
+			{
+#if VAN_POOL_VALGRIND
+				VALGRIND_MEMPOOL_FREE(&shared(), obj);
+				if (keep_link) {
+					VALGRIND_MAKE_MEM_DEFINED(obj, sizeof(void*));
+				}
+#endif
+				annotate_free(obj, keep_link);
+			}
+
+			// a remote ret may still be past its push, see ret_remote
+			static void free_block(Block* block) noexcept
+			{
+				while (block->pushers_.load(std::memory_order_seq_cst) != 0) {
+					std::this_thread::yield();
+				}
+
+				Provider provider = block->provider_;
+				uint64_t bytes = block->bytes_;
+				annotate_release(block, bytes);
+				provider.free(block, bytes);
+			}
+
+			Obj* pop_free() noexcept
+			{
+				if (!free_ && curr_ >= last_) {
+					refill();
+				}
+
+				Obj* obj;
+				if (free_) {
+					// the link is read while obj is free, annotate_get then closes what is not T
+					obj = free_;
+					expose(obj, sizeof(void*));
+					if (!check_link(obj)) {
+						free_ = nullptr;
+						return pop_free();
+					}
+					free_ = link_of(obj);
+					annotate_get(obj);
+					check_poison(obj);
+				} else {
+					obj = curr_++;
+					annotate_carve(obj);
+					set_block(obj, bump_);
+					annotate_get(obj);
+				}
+				set_live(obj);
+				++block_of(obj)->live_;
+				return obj;
+			}
+
+			void push_free(Obj* obj, Block* block) noexcept
+			{
+				--block->live_;
+				set_next(obj, free_);
+				free_ = obj;
+			}
+
+			static Shared& shared() noexcept
+			{
+				static Shared inst;
+				return inst;
+			}
+
+			static Inbox* alloc_inbox() noexcept
+			{
+				Shared& sh = shared();
+				std::lock_guard<std::mutex> lock(sh.mutex_);
+
+				Inbox* inbox = sh.inboxes_;
+				if (inbox) {
+					sh.inboxes_ = inbox->next_;
+				} else {
+					inbox = new Inbox;
+				}
+				inbox->pending_.store(false, std::memory_order_relaxed);
+				return inbox;
+			}
+
+			static void free_inbox(Inbox* inbox) noexcept
+			{
+				Shared& sh = shared();
+				std::lock_guard<std::mutex> lock(sh.mutex_);
+
+				inbox->next_ = sh.inboxes_;
+				sh.inboxes_ = inbox;
+			}
+
+			// once obj is pushed the owner may reclaim it and free the block, so the
+			// pusher pins the block before the push and free_block waits for the pin
+			// seq_cst : an owner that reclaimed obj sees the pin
+			// seq_cst on remote_ and pending_ : a set flag seen by the pusher was not yet consumed
+			// seq_cst on remote_ and inbox_ : either abandon collects obj or the pusher sees
+			// no inbox and collects it, freeing the block if obj was its last live object
+			static void ret_remote(Obj* obj) noexcept
+			{
+				Block* block = block_of(obj);
+				block->pushers_.fetch_add(1, std::memory_order_seq_cst);
+
+				Obj* head = block->remote_.load(std::memory_order_relaxed);
+				do {
+					set_next(obj, head);
+				} while (!block->remote_.compare_exchange_weak(head, obj, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+				Inbox* inbox = block->inbox_.load(std::memory_order_seq_cst);
+				if (inbox && !inbox->pending_.load(std::memory_order_seq_cst)) {
+					inbox->pending_.store(true, std::memory_order_seq_cst);
+				}
+				Block* empty = inbox ? nullptr : shared().collect(block);
+				block->pushers_.fetch_sub(1, std::memory_order_release);
+
+				if (empty) free_block(empty);
+			}
+
+			// only the owner pops, and it takes the whole list at once, so no ABA
+			uint64_t reclaim(Block* block) noexcept
+			{
+				uint64_t n = 0;
+				Obj* obj = block->remote_.exchange(nullptr, std::memory_order_seq_cst);
+				while (obj) {
+					Obj* next = next_of(obj);
+					set_next(obj, free_);
+					free_ = obj;
+					obj = next;
+					++n;
+				}
+				block->live_ -= n;
+				add(remote_cnt_, n);
+				return n;
+			}
+
+			void reclaim() noexcept
+			{
+				if (!inbox_->pending_.exchange(false, std::memory_order_seq_cst)) return;
+
+				uint64_t n = 0;
+				for (Block* block = blocks_; block; block = block->next_) {
+					if (block->remote_.load(std::memory_order_seq_cst)) {
+						n += reclaim(block);
+					}
+				}
+				count_ret(n);
+			}
+
+			// slow path : remote returns, then abandoned blocks, then malloc
+			void refill() noexcept
+			{
+				reclaim();
+				while (!free_) {
+					if (!adopt()) {
+						new_block();
+						return;
+					}
+				}
+			}
+
+			bool adopt() noexcept
+			{
+				Block* block = shared().adopt(this, inbox_);
+				if (!block) return false;
+
+				block->next_ = blocks_;
+				blocks_ = block;
+
+				begin_stat();
+				add(total_cnt_, block->cnt_);
+				add(block_cnt_, 1);
+				add(reserved_, block->bytes_);
+				count_adopted(block->live_);
+
+				Obj* obj = block->free_;
+				while (obj) {
+					Obj* next = next_of(obj);
+					set_next(obj, free_);
+					free_ = obj;
+					obj = next;
+				}
+				block->free_ = nullptr;
+
+				count_ret(reclaim(block));
+				end_stat();
+				return true;
+			}
+
+			void new_block() noexcept
+			{
+				// the provider's unit is filled with objects, not left as a tail
+				uint64_t bytes = round_up(block_bytes(cnt_), provider_.unit());
+				int cnt = static_cast<int>((bytes - header_bytes()) / sizeof(Obj));
+				if (compact_ && block_bytes(cnt) > span()) {
+					cnt = static_cast<int>((span() - header_bytes()) / sizeof(Obj));
+					bytes = round_up(block_bytes(cnt), provider_.unit());
+				}
+
+				size_t align = compact_ ? span() : alignof(Obj);
+				Provider provider = provider_;
+				void* p = provider.alloc(bytes, align);
+				if (!p) {
+					provider = Provider();
+					p = provider.alloc(bytes, align);
+					add(fallback_cnt_, 1);
+				}
+
+				Block* block = new (p) Block;
+				block->provider_ = provider;
+				block->next_ = blocks_;
+				block->owner_.store(this, std::memory_order_relaxed);
+				block->inbox_.store(inbox_, std::memory_order_relaxed);
+				block->remote_.store(nullptr, std::memory_order_relaxed);
+				block->pushers_.store(0, std::memory_order_relaxed);
+				block->prev_ = nullptr;
+				block->free_ = nullptr;
+				block->live_ = 0;
+				block->cnt_ = cnt;
+				block->bytes_ = bytes;
+				blocks_ = block;
+				bump_ = block;
+
+				curr_ = reinterpret_cast<Obj*>(reinterpret_cast<char*>(block) + header_bytes());
+				last_  = curr_ + cnt;
+				annotate_block(curr_, cnt);
+
+				begin_stat();
+				add(total_cnt_, cnt);
+				add(block_cnt_, 1);
+				add(grow_cnt_, 1);
+				add(reserved_, bytes);
+				end_stat();
+				cnt_ = growth_.next(cnt, total_cnt_.load(std::memory_order_relaxed));
+			}
+
+		};
+
+
+		/*******************************************
+		 * lock-free pool
+		 *  - treiber stack over Obj::next_
+		 *  - head is (tag << ptr_bits_ | ptr), tag is bumped on every pop (ABA)
+		 *  - blocks are only carved under grow_mutex_ when the stack runs dry
+		 *  - Pool<T> is a private base : its get/ret/trim are single-owner and
+		 *    free objects live in the stack, not in free_
+		 *  - get reads the link of an object another thread may have popped, so
+		 *    sanitizers keep the link word addressable (link_of, keep_link) : a use
+		 *    after ret through it, or a double ret of a T no bigger than it, goes unseen
+		 *  - trim drains the stack under grow_mutex_, pushes back the objects of the
+		 *    blocks it keeps and frees the others once no get that saw the old top
+		 *    is still running, request_trim is applied by the next ret
+		 *******************************************/
+		template <class T>
+		class LockFreePool : private Pool<T> {
+		private:
+			using Obj = typename Pool<T>::Obj;
+			using Block = typename Pool<T>::Block;
+			using Stripe = PoolBase::Stripe;
+
+			static constexpr int ptr_bits_ = (sizeof(void*) == 8) ? 48 : 32;
+			static constexpr uint64_t ptr_mask_ = (uint64_t(1) << ptr_bits_) - 1;
+
+			std::atomic<uint64_t> head_{0};
+			std::mutex grow_mutex_;
+
+		public:
+			using value_type = T;
+
+			LockFreePool(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+				: Pool<T>(cnt, growth, provider)
+			{
+				// without stripes gets are not tracked and trim releases nothing
+				void* p = aligned_malloc(sizeof(Stripe) * this->stripe_cnt_, alignof(Stripe));
+				if (p) {
+					Stripe* stripes = static_cast<Stripe*>(p);
+					for (int i=0; i<this->stripe_cnt_; ++i) {
+						stripes[i].get_cnt_.store(0, std::memory_order_relaxed);
+						stripes[i].ret_cnt_.store(0, std::memory_order_relaxed);
+						stripes[i].enter_cnt_.store(0, std::memory_order_relaxed);
+					}
+					this->stripes_.store(stripes, std::memory_order_release);
+				}
+				if (cnt > 0) {
+					std::lock_guard<std::mutex> lock(grow_mutex_);
+					carve();
+				}
+			}
+
+			// seq_cst : a get whose head load precedes a trim's drain was seen entering by it
+			T* get() noexcept
+			{
+				Stripe* stripe = enter();
+				uint64_t head = head_.load(std::memory_order_seq_cst);
+				for (;;) {
+					Obj* obj = ptr(head);
+					if (!obj) {
+						grow();
+						head = head_.load(std::memory_order_seq_cst);
+						continue;
+					}
+
+					// hardened : a link failing its canary is only broken if obj is still the top,
+					// the stack is then cut at obj by a cas from that same head, so an object
+					// pushed meanwhile is never lost
+					Obj* stored = this->relaxed_load(&obj->next_);
+					if (!this->link_ok(obj, stored)) {
+						uint64_t now = head_.load(std::memory_order_seq_cst);
+						if (now == head) {
+							Hardened::fault(Hardened::Fault::bad_link, this->type_name(), obj);
+							head_.compare_exchange_strong(now, pack(nullptr, tag(head) + 1), std::memory_order_seq_cst, std::memory_order_seq_cst);
+						}
+						head = head_.load(std::memory_order_seq_cst);
+						continue;
+					}
+
+					uint64_t next = pack(this->decode(obj, stored), tag(head) + 1);
+					if (head_.compare_exchange_weak(head, next, std::memory_order_seq_cst, std::memory_order_seq_cst)) {
+						this->annotate_get(obj, true);
+						this->check_poison(obj);
+						this->set_live(obj);
+						leave(stripe);
+						return &(obj->inst_);
+					}
+				}
+			}
+
+			void ret(T* t) noexcept
+			{
+				Obj* obj = reinterpret_cast<Obj*>(t);
+				if (!this->check_ret(obj, &grow_mutex_)) return;
+				this->annotate_ret(obj, true);
+
+				count_rets(1);
+				push(obj, obj);
+				check_trim();
+			}
+
+			void get_n(T** out, size_t n) noexcept
+			{
+				for (size_t i=0; i<n; ++i) {
+					out[i] = get();
+				}
+			}
+
+			// link the batch and publish it with a single cas
+			void ret_n(T** in, size_t n) noexcept
+			{
+				Obj* first = nullptr;
+				Obj* last = nullptr;
+				int64_t cnt = 0;
+				for (size_t i=0; i<n; ++i) {
+					Obj* obj = reinterpret_cast<Obj*>(in[i]);
+					if (!this->check_ret(obj, &grow_mutex_)) continue;
+					this->annotate_ret(obj, true);
+
+					if (last) {
+						this->set_link(last, obj);
+					} else {
+						first = obj;
+					}
+					last = obj;
+					++cnt;
+				}
+				if (!first) return;
+
+				count_rets(cnt);
+				push(first, last);
+				check_trim();
+			}
+
+			// any thread : release blocks whose objects are all free until at most bytes
+			// are reserved, returns the released bytes
+			uint64_t shrink_to(uint64_t bytes) noexcept
+			{
+				this->trim_to_.store(this->no_trim_, std::memory_order_relaxed);
+				Stripe* stripes = this->stripes_.load(std::memory_order_relaxed);
+				if (!stripes) return 0;
+
+				Block* dead = nullptr;
+				uint64_t released = 0;
+				{
+					std::lock_guard<std::mutex> lock(grow_mutex_);
+					uint64_t reserved = this->reserved_.load(std::memory_order_relaxed);
+					if (reserved <= bytes) return 0;
+
+					// a get holding the old top fails its cas on the bumped tag
+					uint64_t head = head_.load(std::memory_order_seq_cst);
+					while (!head_.compare_exchange_weak(head, pack(nullptr, tag(head) + 1), std::memory_order_seq_cst, std::memory_order_seq_cst)) {
+					}
+					Obj* chain = ptr(head);
+
+					// live_ is unused here : it counts each block's objects on the stack
+					// hardened : the chain is cut at a broken link, end is past the trusted part
+					Obj* end = nullptr;
+					for (Obj* obj = chain; obj; obj = this->link_of(obj)) {
+						if (!this->check_link(obj)) {
+							end = obj;
+							break;
+						}
+						++this->block_of(obj)->live_;
+					}
+
+					// released blocks are marked by a null owner
+					for (Block* block = this->blocks_; block && reserved > bytes; block = block->next_) {
+						if (block->live_ == static_cast<uint64_t>(block->cnt_)) {
+							block->owner_.store(nullptr, std::memory_order_relaxed);
+							reserved -= block->bytes_;
+						}
+					}
+
+					Obj* first = nullptr;
+					Obj* last = nullptr;
+					for (Obj* obj = chain; obj != end; ) {
+						Obj* next = this->link_of(obj);
+						if (this->block_of(obj)->owner_.load(std::memory_order_relaxed)) {
+							if (last) {
+								this->set_link(last, obj);
+							} else {
+								first = obj;
+							}
+							last = obj;
+						}
+						obj = next;
+					}
+					if (first) push(first, last);
+
+					if (this->bump_ && !this->bump_->owner_.load(std::memory_order_relaxed)) {
+						this->bump_ = nullptr;
+						this->curr_ = nullptr;
+						this->last_ = nullptr;
+					}
+
+					this->begin_stat();
+					Block** blink = &this->blocks_;
+					while (*blink) {
+						Block* block = *blink;
+						block->live_ = 0;
+						if (!block->owner_.load(std::memory_order_relaxed)) {
+							*blink = block->next_;
+							this->sub(this->total_cnt_, block->cnt_);
+							this->sub(this->block_cnt_, 1);
+							this->sub(this->reserved_, block->bytes_);
+							released += block->bytes_;
+							block->next_ = dead;
+							dead = block;
+						} else {
+							blink = &block->next_;
+						}
+					}
+					this->end_stat();
+				}
+
+				wait_gets(stripes);
+				while (dead) {
+					Block* next = dead->next_;
+					this->free_block(dead);
+					dead = next;
+				}
+				return released;
+			}
+
+			uint64_t trim() noexcept
+			{
+				return shrink_to(0);
+			}
+
+			// stats and request_trim only, safe from any thread
+			PoolBase& base() noexcept
+			{
+				return *this;
+			}
+
+		private:
+			static Obj* ptr(uint64_t v) noexcept
+			{
+				return reinterpret_cast<Obj*>(static_cast<uintptr_t>(v & ptr_mask_));
+			}
+
+			static uint64_t tag(uint64_t v) noexcept
+			{
+				return v >> ptr_bits_;
+			}
+
+			// one padded stripe per thread slot, no shared counter line on get/ret
+			Stripe* enter() noexcept
+			{
+				Stripe* stripes = this->stripes_.load(std::memory_order_relaxed);
+				if (!stripes) return nullptr;
+
+				Stripe* stripe = &stripes[this->stripe_of_thread()];
+				stripe->enter_cnt_.fetch_add(1, std::memory_order_seq_cst);
+				return stripe;
+			}
+
+			// release : a trim that sees the get done may free what it read
+			static void leave(Stripe* stripe) noexcept
+			{
+				if (stripe) stripe->get_cnt_.fetch_add(1, std::memory_order_release);
+			}
+
+			void count_rets(int64_t n) noexcept
+			{
+#if VAN_POOL_STATS
+				Stripe* stripes = this->stripes_.load(std::memory_order_relaxed);
+				if (stripes) {
+					stripes[this->stripe_of_thread()].ret_cnt_.fetch_add(static_cast<uint64_t>(n), std::memory_order_release);
+				}
+#else
+				(void)n;
+#endif
+			}
+
+			// every get running at the drain has left once a stripe shows as many done as
+			// started : done is read first and both only grow, so no get was in between
+			void wait_gets(Stripe* stripes) noexcept
+			{
+				for (int i=0; i<this->stripe_cnt_; ++i) {
+					for (;;) {
+						uint64_t done = stripes[i].get_cnt_.load(std::memory_order_seq_cst);
+						if (stripes[i].enter_cnt_.load(std::memory_order_seq_cst) == done) break;
+						std::this_thread::yield();
+					}
+				}
+			}
+
+			void check_trim() noexcept
+			{
+				if (this->trim_to_.load(std::memory_order_relaxed) == this->no_trim_) return;
+
+				uint64_t bytes = this->trim_to_.exchange(this->no_trim_, std::memory_order_relaxed);
+				if (bytes != this->no_trim_) shrink_to(bytes);
+			}
+
+			static uint64_t pack(Obj* obj, uint64_t tag) noexcept
+			{
+				return (tag << ptr_bits_) | (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(obj)) & ptr_mask_);
+			}
+
+			void push(Obj* first, Obj* last) noexcept
+			{
+				uint64_t head = head_.load(std::memory_order_relaxed);
+				do {
+					this->set_link(last, ptr(head));
+				} while (!head_.compare_exchange_weak(head, pack(first, tag(head)), std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			void grow() noexcept
+			{
+				std::lock_guard<std::mutex> lock(grow_mutex_);
+				if (ptr(head_.load(std::memory_order_acquire))) return;
+
+				carve();
+			}
+
+			// link [curr_, last_) into one chain and publish it with a single cas
+			void carve() noexcept
+			{
+				if (this->curr_ >= this->last_) {
+					this->new_block();
+				}
+
+				Obj* first = this->curr_;
+				Obj* last = this->last_ - 1;
+				for (Obj* obj = first; obj < last; ++obj) {
+					this->annotate_carve(obj);
+					this->set_block(obj, this->bump_);
+					this->poison(obj);
+					this->set_link(obj, obj + 1);
+					this->annotate_free(obj, true);
+				}
+				this->annotate_carve(last);
+				this->set_block(last, this->bump_);
+				this->poison(last);
+				this->annotate_free(last, true);
+				this->curr_ = this->last_;
+
+				push(first, last);
+			}
+
+		};
+
+		template <int size, size_t align = 1>
+		class alignas(align) Mem {
+		private:
+			static_assert(size > 0, "too small size");
+			static_assert(align > 0 && (align & (align - 1)) == 0, "align must be a power of two");
+
+		public:
+			static constexpr int len_ = size;
+			static constexpr size_t align_ = align;
+			char buf_[size];
+		};
+
+
+
+		/*******************************************
+		 * call construct, destruct
+		 *******************************************/
+		template <class T, class... Args>
+		void construct(T* t, Args&&... args) noexcept
+		{
+			new (t) T (std::forward<Args>(args)...);
+		}
+
+		template <class T>
+		void destruct(T* t) noexcept
+		{
+			t->~T();
+		}
+
+
+		/*******************************************
+		 * tls pool
+		 *  - blocks come from the heap unless a provider is given on the thread's first
+		 *    use : warm_up_tls_pool<T>(cnt, growth, Provider::numa_local()) keeps each
+		 *    thread's blocks on its own node
+		 *******************************************/
+		template <class T>
+		Pool<T>& get_tls_pool(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			thread_local Pool<T> pool(cnt, growth, provider);
+			return pool;
+		}
+
+		template <class T> 
+		void warm_up_tls_pool(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			get_tls_pool<T>(cnt, growth, provider);
+		}
+
+		template <class T>
+		T* get_tls() noexcept
+		{
+			return get_tls_pool<T>().get();
+		}
+
+		template <class T>
+		void ret_tls(T* t) noexcept
+		{
+			get_tls_pool<T>().ret(t);
+		}
+
+		template <class T>
+		void get_tls_n(T** out, size_t n) noexcept
+		{
+			get_tls_pool<T>().get_n(out, n);
+		}
+
+		template <class T>
+		void ret_tls_n(T** in, size_t n) noexcept
+		{
+			get_tls_pool<T>().ret_n(in, n);
+		}
+
+		template <int size>
+		void warm_up_tls_pool(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			using T = Mem<size>;
+			get_tls_pool<T>(cnt, growth, provider);
+		}
+
+		template <int size>
+		Mem<size>* get_tls() noexcept
+		{
+			using T = Mem<size>;
+			return get_tls_pool<T>().get();
+		}
+
+
+		/*******************************************
+		 * singleton pool
+		 *******************************************/
+		template <class T>
+		Pool<T>& get_singleton_pool(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			static Pool<T> pool(cnt, growth, provider);
+			return pool;
+		}
+
+		template <class T>
+		std::mutex& get_singleton_mutex() noexcept
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		template <class T>
+		void warm_up_singleton(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			get_singleton_pool<T>(cnt, growth, provider);
+		}
+
+		template <class T>
+		T* get_singleton() noexcept
+		{
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			return get_singleton_pool<T>().get();
+		}
+
+		template <class T>
+		void ret_singleton(T* t) noexcept
+		{
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			get_singleton_pool<T>().ret(t);
+		}
+
+		// one lock per batch
+		template <class T>
+		void get_singleton_n(T** out, size_t n) noexcept
+		{
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			get_singleton_pool<T>().get_n(out, n);
+		}
+
+		template <class T>
+		void ret_singleton_n(T** in, size_t n) noexcept
+		{
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			get_singleton_pool<T>().ret_n(in, n);
+		}
+
+		template <int size>
+		void warm_up_singleton(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			using T = Mem<size>;
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			get_singleton_pool<T>(cnt, growth, provider);
+		}
+
+		template <int size>
+		Mem<size>* get_singleton() noexcept
+		{
+			using T = Mem<size>;
+			std::lock_guard<std::mutex> lock(get_singleton_mutex<T>());
+			return get_singleton_pool<T>().get();
+		}
+
+
+		/*******************************************
+		 * numa singleton pool
+		 *  - one locked pool per node, blocks bound to that node
+		 *  - get and ret use the shard of the calling thread's node,
+		 *    objects of another node go back through its remote queue
+		 *  - a single node machine has one shard, same as the singleton pool
+		 *******************************************/
+		template <class T>
+		class NumaPool {
+		private:
+			struct Shard {
+				std::mutex mutex_;
+				Pool<T> pool_;
+
+				Shard(int cnt, Growth growth, Provider provider) noexcept
+					: pool_(cnt, growth, provider)
+				{
+				}
+			};
+			std::vector<std::unique_ptr<Shard>> shards_;
+
+		public:
+			NumaPool(int cnt = 0, Growth growth = Growth(), bool huge = false)
+			{
+				for (int node=0; node<numa_node_cnt(); ++node) {
+					shards_.emplace_back(new Shard(cnt, growth, provider_of(node, huge)));
+				}
+			}
+
+			NumaPool(const NumaPool<T>&) = delete;
+			NumaPool& operator=(const NumaPool<T>&) = delete;
+
+			T* get() noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<std::mutex> lock(shard.mutex_);
+				return shard.pool_.get();
+			}
+
+			void ret(T* t) noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<std::mutex> lock(shard.mutex_);
+				shard.pool_.ret(t);
+			}
+
+			void get_n(T** out, size_t n) noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<std::mutex> lock(shard.mutex_);
+				shard.pool_.get_n(out, n);
+			}
+
+			void ret_n(T** in, size_t n) noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<std::mutex> lock(shard.mutex_);
+				shard.pool_.ret_n(in, n);
+			}
+
+			int shard_cnt() const noexcept
+			{
+				return static_cast<int>(shards_.size());
+			}
+
+		private:
+			// one node : nothing to bind, blocks come from the heap like the singleton pool
+			static Provider provider_of(int node, bool huge) noexcept
+			{
+				if (numa_node_cnt() == 1) return huge ? Provider::huge() : Provider();
+				return Provider::numa(node, huge);
+			}
+
+			Shard& local() noexcept
+			{
+				return *shards_[static_cast<size_t>(numa_node()) % shards_.size()];
+			}
+		};
+
+		template <class T>
+		NumaPool<T>& get_numa_pool(int cnt = 0, Growth growth = Growth(), bool huge = false)
+		{
+			static NumaPool<T> pool(cnt, growth, huge);
+			return pool;
+		}
+
+		template <class T>
+		void warm_up_numa(int cnt, Growth growth = Growth(), bool huge = false)
+		{
+			get_numa_pool<T>(cnt, growth, huge);
+		}
+
+		template <class T>
+		T* get_numa() noexcept
+		{
+			return get_numa_pool<T>().get();
+		}
+
+		template <class T>
+		void ret_numa(T* t) noexcept
+		{
+			get_numa_pool<T>().ret(t);
+		}
+
+		template <int size>
+		void warm_up_numa(int cnt, Growth growth = Growth(), bool huge = false)
+		{
+			using T = Mem<size>;
+			get_numa_pool<T>(cnt, growth, huge);
+		}
+
+		template <int size>
+		Mem<size>* get_numa() noexcept
+		{
+			using T = Mem<size>;
+			return get_numa_pool<T>().get();
+		}
+
+
+		/*******************************************
+		 * per-cpu pool
+		 *  - one pool per cpu, memory grows with cores instead of threads
+		 *  - the shard lock is almost never contended : only a thread preempted or
+		 *    migrated inside get/ret meets another one on the same shard
+		 *  - shards bind their blocks to the cpu's node on numa machines
+		 *  - without sched_getcpu threads are spread over the shards round robin
+		 *******************************************/
+		class SpinLock {
+		private:
+			std::atomic<bool> locked_{false};
+
+		public:
+			void lock() noexcept
+			{
+				for (;;) {
+					if (!locked_.exchange(true, std::memory_order_acquire)) return;
+					while (locked_.load(std::memory_order_relaxed)) {
+						std::this_thread::yield();
+					}
+				}
+			}
+
+			void unlock() noexcept
+			{
+				locked_.store(false, std::memory_order_release);
+			}
+		};
+
+		inline int cpu_cnt() noexcept
+		{
+			static const int cnt = []() {
+				int n = static_cast<int>(std::thread::hardware_concurrency());
+#ifdef VAN_POOL_NUMA
+				int conf = static_cast<int>(sysconf(_SC_NPROCESSORS_CONF));
+				if (conf > n) n = conf;
+#endif
+				return (n > 0) ? n : 1;
+			}();
+			return cnt;
+		}
+
+		inline int current_cpu() noexcept
+		{
+#ifdef VAN_POOL_NUMA
+			int cpu = sched_getcpu();
+			if (cpu >= 0) return cpu;
+#endif
+			static std::atomic<int> next{0};
+			thread_local int cpu_of_thread = next.fetch_add(1, std::memory_order_relaxed);
+			return cpu_of_thread;
+		}
+
+		template <class T>
+		class CpuPool {
+		private:
+			struct alignas(64) Shard {
+				SpinLock lock_;
+				Pool<T> pool_;
+
+				Shard(int cnt, Growth growth, Provider provider) noexcept
+					: pool_(cnt, growth, provider)
+				{
+				}
+
+				// plain new ignores extended alignment before c++17
+				static void* operator new(size_t bytes)
+				{
+					void* p = aligned_malloc(bytes, alignof(Shard));
+					if (!p) throw std::bad_alloc();
+					return p;
+				}
+
+				static void operator delete(void* p) noexcept
+				{
+					aligned_free(p);
+				}
+			};
+			std::vector<std::unique_ptr<Shard>> shards_;
+
+		public:
+			CpuPool(int cnt = 0, Growth growth = Growth())
+			{
+				for (int cpu=0; cpu<cpu_cnt(); ++cpu) {
+					shards_.emplace_back(new Shard(cnt, growth, provider_of(cpu)));
+				}
+			}
+
+			CpuPool(const CpuPool<T>&) = delete;
+			CpuPool& operator=(const CpuPool<T>&) = delete;
+
+			T* get() noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<SpinLock> lock(shard.lock_);
+				return shard.pool_.get();
+			}
+
+			void ret(T* t) noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<SpinLock> lock(shard.lock_);
+				shard.pool_.ret(t);
+			}
+
+			void get_n(T** out, size_t n) noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<SpinLock> lock(shard.lock_);
+				shard.pool_.get_n(out, n);
+			}
+
+			void ret_n(T** in, size_t n) noexcept
+			{
+				Shard& shard = local();
+				std::lock_guard<SpinLock> lock(shard.lock_);
+				shard.pool_.ret_n(in, n);
+			}
+
+			int shard_cnt() const noexcept
+			{
+				return static_cast<int>(shards_.size());
+			}
+
+		private:
+			static Provider provider_of(int cpu) noexcept
+			{
+				if (numa_node_cnt() == 1) return Provider();
+#ifdef VAN_POOL_NUMA
+				const std::vector<int>& nodes = numa_cpu_nodes();
+				if (cpu < static_cast<int>(nodes.size())) return Provider::numa(nodes[cpu]);
+#endif
+				return Provider();
+			}
+
+			Shard& local() noexcept
+			{
+				return *shards_[static_cast<size_t>(current_cpu()) % shards_.size()];
+			}
+		};
+
+		template <class T>
+		CpuPool<T>& get_cpu_pool(int cnt = 0, Growth growth = Growth())
+		{
+			static CpuPool<T> pool(cnt, growth);
+			return pool;
+		}
+
+		template <class T>
+		void warm_up_cpu(int cnt, Growth growth = Growth())
+		{
+			get_cpu_pool<T>(cnt, growth);
+		}
+
+		template <class T>
+		T* get_cpu() noexcept
+		{
+			return get_cpu_pool<T>().get();
+		}
+
+		template <class T>
+		void ret_cpu(T* t) noexcept
+		{
+			get_cpu_pool<T>().ret(t);
+		}
+
+		template <int size>
+		void warm_up_cpu(int cnt, Growth growth = Growth())
+		{
+			using T = Mem<size>;
+			get_cpu_pool<T>(cnt, growth);
+		}
+
+		template <int size>
+		Mem<size>* get_cpu() noexcept
+		{
+			using T = Mem<size>;
+			return get_cpu_pool<T>().get();
+		}
+
+
+		/*******************************************
+		 * lock-free singleton pool
+		 *******************************************/
+		template <class T>
+		LockFreePool<T>& get_lockfree_pool(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			static LockFreePool<T> pool(cnt, growth, provider);
+			return pool;
+		}
+
+		template <class T>
+		void warm_up_lockfree(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			get_lockfree_pool<T>(cnt, growth, provider);
+		}
+
+		template <class T>
+		T* get_lockfree() noexcept
+		{
+			return get_lockfree_pool<T>().get();
+		}
+
+		template <class T>
+		void ret_lockfree(T* t) noexcept
+		{
+			get_lockfree_pool<T>().ret(t);
+		}
+
+		template <int size>
+		void warm_up_lockfree(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			using T = Mem<size>;
+			get_lockfree_pool<T>(cnt, growth, provider);
+		}
+
+		template <int size>
+		Mem<size>* get_lockfree() noexcept
+		{
+			using T = Mem<size>;
+			return get_lockfree_pool<T>().get();
+		}
+
+
+		/*******************************************
+		 * magazine depot
+		 *  - bonwick style : each thread keeps a loaded and a previous magazine
+		 *  - the depot lock is only taken when both are empty (get) or full (ret)
+		 *  - objects sitting in magazines are counted as used by the depot pool
+		 *  - the depot keeps at most full_max_ full magazines, so threads that
+		 *    only return cannot pin blocks against trim
+		 *******************************************/
+		template <class T>
+		class Depot {
+		public:
+			static constexpr int mag_size_ = VAN_POOL_MAGAZINE_SIZE;
+			static_assert(mag_size_ > 0, "too small magazine size");
+			static constexpr int full_max_ = VAN_POOL_DEPOT_FULL;
+
+			struct Magazine {
+				Magazine* next_;
+				int cnt_;
+				T* objs_[mag_size_];
+			};
+
+		private:
+			std::mutex mutex_;
+			Pool<T> pool_;
+
+			Magazine* full_ = nullptr;
+			Magazine* empty_ = nullptr;
+			int full_cnt_ = 0;
+
+		public:
+			Depot(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+				: pool_(cnt, growth, provider)
+			{
+			}
+
+			~Depot() noexcept
+			{
+				release(full_);
+				release(empty_);
+			}
+
+			Depot(const Depot<T>&) = delete;
+			Depot& operator=(const Depot<T>&) = delete;
+
+			Magazine* alloc_empty() noexcept
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return pop_empty();
+			}
+
+			// give back an empty magazine, take a full one
+			Magazine* exchange_full(Magazine* empty) noexcept
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				push(empty_, empty);
+
+				if (full_) {
+					--full_cnt_;
+					return pop(full_);
+				}
+
+				Magazine* mag = pop_empty();
+				while (mag->cnt_ < mag_size_) {
+					mag->objs_[mag->cnt_++] = pool_.get();
+				}
+				return mag;
+			}
+
+			// give back a full magazine, take an empty one
+			// past full_max_ the objects go back to the pool and the magazine itself is the empty one
+			Magazine* exchange_empty(Magazine* full) noexcept
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (full_cnt_ >= full_max_) {
+					pool_.ret_n(full->objs_, static_cast<size_t>(full->cnt_));
+					full->cnt_ = 0;
+					return full;
+				}
+
+				++full_cnt_;
+				push(full_, full);
+				return pop_empty();
+			}
+
+			// thread exit : objects go back to the pool, the magazine is kept
+			void drain(Magazine* mag) noexcept
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				while (mag->cnt_ > 0) {
+					pool_.ret(mag->objs_[--mag->cnt_]);
+				}
+				push(empty_, mag);
+			}
+
+		private:
+			static void push(Magazine*& list, Magazine* mag) noexcept
+			{
+				mag->next_ = list;
+				list = mag;
+			}
+
+			static Magazine* pop(Magazine*& list) noexcept
+			{
+				Magazine* mag = list;
+				list = mag->next_;
+				return mag;
+			}
+
+			Magazine* pop_empty() noexcept
+			{
+				if (empty_) {
+					return pop(empty_);
+				}
+
+				Magazine* mag = reinterpret_cast<Magazine*>(malloc(sizeof(Magazine)));
+				mag->next_ = nullptr;
+				mag->cnt_ = 0;
+				return mag;
+			}
+
+			static void release(Magazine* mag) noexcept
+			{
+				while (mag) {
+					Magazine* next = mag->next_;
+					free(mag);
+					mag = next;
+				}
+			}
+
+		};
+
+		template <class T>
+		class MagazineCache {
+		private:
+			using Magazine = typename Depot<T>::Magazine;
+			static constexpr int mag_size_ = Depot<T>::mag_size_;
+
+			Depot<T>& depot_;
+			Magazine* loaded_;
+			Magazine* prev_;
+
+		public:
+			MagazineCache(Depot<T>& depot) noexcept
+				: depot_(depot)
+				, loaded_(depot.alloc_empty())
+				, prev_(depot.alloc_empty())
+			{
+			}
+
+			~MagazineCache() noexcept
+			{
+				depot_.drain(loaded_);
+				depot_.drain(prev_);
+			}
+
+			MagazineCache(const MagazineCache<T>&) = delete;
+			MagazineCache& operator=(const MagazineCache<T>&) = delete;
+
+			T* get() noexcept
+			{
+				if (loaded_->cnt_ == 0) {
+					if (prev_->cnt_ > 0) {
+						std::swap(loaded_, prev_);
+					} else {
+						Magazine* full = depot_.exchange_full(prev_);
+						prev_ = loaded_;
+						loaded_ = full;
+					}
+				}
+				return loaded_->objs_[--loaded_->cnt_];
+			}
+
+			void ret(T* t) noexcept
+			{
+				if (loaded_->cnt_ == mag_size_) {
+					if (prev_->cnt_ < mag_size_) {
+						std::swap(loaded_, prev_);
+					} else {
+						Magazine* empty = depot_.exchange_empty(prev_);
+						prev_ = loaded_;
+						loaded_ = empty;
+					}
+				}
+				loaded_->objs_[loaded_->cnt_++] = t;
+			}
+
+		};
+
+
+		/*******************************************
+		 * magazine cached singleton pool
+		 *******************************************/
+		template <class T>
+		Depot<T>& get_depot(int cnt = 0, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			static Depot<T> depot(cnt, growth, provider);
+			return depot;
+		}
+
+		template <class T>
+		MagazineCache<T>& get_magazine_cache() noexcept
+		{
+			thread_local MagazineCache<T> cache(get_depot<T>());
+			return cache;
+		}
+
+		template <class T>
+		void warm_up_cached(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			get_depot<T>(cnt, growth, provider);
+		}
+
+		template <class T>
+		T* get_cached() noexcept
+		{
+			return get_magazine_cache<T>().get();
+		}
+
+		template <class T>
+		void ret_cached(T* t) noexcept
+		{
+			get_magazine_cache<T>().ret(t);
+		}
+
+		template <int size>
+		void warm_up_cached(int cnt, Growth growth = Growth(), Provider provider = Provider()) noexcept
+		{
+			using T = Mem<size>;
+			get_depot<T>(cnt, growth, provider);
+		}
+
+		template <int size>
+		Mem<size>* get_cached() noexcept
+		{
+			using T = Mem<size>;
+			return get_magazine_cache<T>().get();
+		}
+
+
+		/*******************************************
+		 * heap fallbacks
+		 *  - requests no pool serves : oversized size class requests,
+		 *    allocator arrays, oversized or over-aligned pmr requests
+		 *******************************************/
+		class FallbackStat {
+		public:
+			uint64_t size_class_ = 0;
+			uint64_t allocator_ = 0;
+			uint64_t resource_ = 0;
+		};
+
+		class Fallback {
+		public:
+			std::atomic<uint64_t> size_class_{0};
+			std::atomic<uint64_t> allocator_{0};
+			std::atomic<uint64_t> resource_{0};
+
+			static Fallback& inst() noexcept
+			{
+				static Fallback inst;
+				return inst;
+			}
+
+			// already on a malloc path, one shared counter is cheap next to it
+			static void count(std::atomic<uint64_t>& cnt) noexcept
+			{
+#if VAN_POOL_STATS
+				cnt.fetch_add(1, std::memory_order_relaxed);
+#else
+				(void)cnt;
+#endif
+			}
+
+			FallbackStat stat() noexcept
+			{
+				FallbackStat st;
+				st.size_class_ = size_class_.load(std::memory_order_relaxed);
+				st.allocator_ = allocator_.load(std::memory_order_relaxed);
+				st.resource_ = resource_.load(std::memory_order_relaxed);
+				return st;
+			}
+		};
+
+
+		/*******************************************
+		 * size classes
+		 *  - 16 byte steps up to 128, then 4 classes per power of two up to 64KB
+		 *  - class n is served by the tls or singleton pool of Mem<size_class_bytes(n), alignof(std::max_align_t)>,
+ *    so every result is aligned like malloc's
+		 *  - bigger requests fall back to malloc
+		 *******************************************/
+		struct TlsMode {};
+		struct SingletonMode {};
+
+		template <class T>
+		T* get_mode(TlsMode) noexcept
+		{
+			return get_tls<T>();
+		}
+
+		template <class T>
+		T* get_mode(SingletonMode) noexcept
+		{
+			return get_singleton<T>();
+		}
+
+		template <class T>
+		void ret_mode(T* t, TlsMode) noexcept
+		{
+			ret_tls(t);
+		}
+
+		template <class T>
+		void ret_mode(T* t, SingletonMode) noexcept
+		{
+			ret_singleton(t);
+		}
+
+		static constexpr size_t size_class_max = 65536;
+
+		constexpr int size_class_log2(size_t n) noexcept
+		{
+			return (n < 2) ? 0 : 1 + size_class_log2(n >> 1);
+		}
+
+		constexpr int size_class_index(size_t size) noexcept
+		{
+			return (size <= 16) ? 0
+				: (size <= 128) ? static_cast<int>((size + 15) / 16 - 1)
+				: 8 + (size_class_log2(size - 1) - 7) * 4 + static_cast<int>(((size - 1) >> (size_class_log2(size - 1) - 2)) & 3);
+		}
+
+		constexpr size_t size_class_bytes(int idx) noexcept
+		{
+			return (idx < 8) ? static_cast<size_t>(idx + 1) * 16
+				: (size_t(1) << (7 + (idx - 8) / 4)) + static_cast<size_t>((idx - 8) % 4 + 1) * (size_t(1) << (5 + (idx - 8) / 4));
+		}
+
+		static constexpr int size_class_cnt = size_class_index(size_class_max) + 1;
+
+		constexpr bool size_class_check(int idx = 0) noexcept
+		{
+			return (idx == size_class_cnt) ? true
+				: size_class_index(size_class_bytes(idx)) == idx
+					&& size_class_index(size_class_bytes(idx) + 1) == idx + 1
+					&& size_class_check(idx + 1);
+		}
+		static_assert(size_class_bytes(size_class_cnt - 1) == size_class_max, "size class table must end at size_class_max");
+		static_assert(size_class_check(), "size class table is not consistent");
+
+		// runtime twin of size_class_index
+		inline int size_class_of(size_t size) noexcept
+		{
+			if (size <= 128) {
+				return (size <= 16) ? 0 : static_cast<int>((size + 15) / 16 - 1);
+			}
+
+			uint64_t s = size - 1;
+#if defined(__GNUC__)
+			int log2 = 63 - __builtin_clzll(s);
+#else
+			int log2 = 0;
+			while (s >> (log2 + 1)) ++log2;
+#endif
+			return 8 + (log2 - 7) * 4 + static_cast<int>((s >> (log2 - 2)) & 3);
+		}
+
+		template <int idx, class Mode>
+		class SizeClass {
+		public:
+			static constexpr int size_ = static_cast<int>(size_class_bytes(idx));
+			using type = Mem<size_, alignof(std::max_align_t)>;
+
+			static void* get() noexcept
+			{
+				return get_mode<type>(Mode());
+			}
+
+			static void ret(void* p) noexcept
+			{
+				ret_mode(static_cast<type*>(p), Mode());
+			}
+		};
+
+		struct SizeClassFn {
+			void* (*get_)();
+			void (*ret_)(void*);
+		};
+
+		template <int... idx>
+		struct IndexSeq {};
+
+		template <int n, int... idx>
+		struct MakeIndexSeq : MakeIndexSeq<n - 1, n - 1, idx...> {};
+
+		template <int... idx>
+		struct MakeIndexSeq<0, idx...> {
+			using type = IndexSeq<idx...>;
+		};
+
+		template <class Mode, int... idx>
+		const SizeClassFn* size_class_table(IndexSeq<idx...>) noexcept
+		{
+			static const SizeClassFn table[] = { { &SizeClass<idx, Mode>::get, &SizeClass<idx, Mode>::ret }... };
+			return table;
+		}
+
+		template <class Mode = TlsMode>
+		const SizeClassFn* size_class_table() noexcept
+		{
+			return size_class_table<Mode>(typename MakeIndexSeq<size_class_cnt>::type());
+		}
+
+		// max_align_t aligned, size must be the one given to alloc()
+		inline void* alloc(size_t size) noexcept
+		{
+			if (size > size_class_max) {
+				Fallback::count(Fallback::inst().size_class_);
+				return malloc(size);
+			}
+			return size_class_table()[size_class_of(size)].get_();
+		}
+
+		inline void dealloc(void* p, size_t size) noexcept
+		{
+			if (!p) return;
+			if (size > size_class_max) {
+				free(p);
+				return;
+			}
+			size_class_table()[size_class_of(size)].ret_(p);
+		}
+
+
+		/*******************************************
+		 * stl allocator
+		 *  - single objects (container nodes) come from the tls or singleton pool
+		 *  - arrays (vector storage, bucket arrays) fall back to aligned_malloc
+		 *  - stateless : every instance is equal and may free the others' memory
+		 *******************************************/
+
+		template <class T, class Mode = TlsMode>
+		class Allocator {
+		public:
+			using value_type = T;
+			using size_type = size_t;
+			using difference_type = ptrdiff_t;
+			using propagate_on_container_copy_assignment = std::false_type;
+			using propagate_on_container_move_assignment = std::true_type;
+			using propagate_on_container_swap = std::false_type;
+			using is_always_equal = std::true_type;
+
+			template <class U>
+			struct rebind {
+				using other = Allocator<U, Mode>;
+			};
+
+		public:
+			Allocator() noexcept = default;
+
+			template <class U>
+			Allocator(const Allocator<U, Mode>&) noexcept
+			{
+			}
+
+			T* allocate(size_t n)
+			{
+				if (n == 1) {
+					return get_mode<T>(Mode());
+				}
+
+				Fallback::count(Fallback::inst().allocator_);
+				void* p = aligned_malloc(n * sizeof(T), alignof(T));
+				if (!p) throw std::bad_alloc();
+				return static_cast<T*>(p);
+			}
+
+			void deallocate(T* p, size_t n) noexcept
+			{
+				if (n == 1) {
+					ret_mode(p, Mode());
+					return;
+				}
+				aligned_free(p);
+			}
+		};
+
+		template <class T, class U, class Mode>
+		bool operator==(const Allocator<T, Mode>&, const Allocator<U, Mode>&) noexcept
+		{
+			return true;
+		}
+
+		template <class T, class U, class Mode>
+		bool operator!=(const Allocator<T, Mode>&, const Allocator<U, Mode>&) noexcept
+		{
+			return false;
+		}
+
+
+		/*******************************************
+		 * smart pointer
+		 *  - make_pooled constructs in place, the deleter destructs and returns
+		 *  - the deleter is empty, so Pooled<T> is the size of a raw pointer
+		 *******************************************/
+		template <class T, class Mode = TlsMode>
+		struct PoolDeleter {
+			void operator()(T* t) const noexcept
+			{
+				destruct(t);
+				ret_mode(t, Mode());
+			}
+		};
+
+		template <class T, class Mode = TlsMode>
+		using Pooled = std::unique_ptr<T, PoolDeleter<T, Mode>>;
+
+		static_assert(sizeof(Pooled<int>) == sizeof(int*), "pooled pointer must not be bigger than a raw pointer");
+
+		template <class T, class Mode, class... Args>
+		Pooled<T, Mode> make_pooled_mode(Args&&... args)
+		{
+			T* t = get_mode<T>(Mode());
+			try {
+				new (t) T (std::forward<Args>(args)...);
+			} catch (...) {
+				ret_mode(t, Mode());
+				throw;
+			}
+			return Pooled<T, Mode>(t);
+		}
+
+		template <class T, class... Args>
+		Pooled<T> make_pooled(Args&&... args)
+		{
+			return make_pooled_mode<T, TlsMode>(std::forward<Args>(args)...);
+		}
+
+		template <class T, class... Args>
+		Pooled<T, SingletonMode> make_pooled_singleton(Args&&... args)
+		{
+			return make_pooled_mode<T, SingletonMode>(std::forward<Args>(args)...);
+		}
+
+
+		/*******************************************
+		 * shared pointer
+		 *  - allocate_shared rebinds Allocator to the control block type,
+		 *    so the count and the object share one pooled slot
+		 *******************************************/
+		template <class T, class Mode, class... Args>
+		std::shared_ptr<T> make_pooled_shared_mode(Args&&... args)
+		{
+			return std::allocate_shared<T>(Allocator<T, Mode>(), std::forward<Args>(args)...);
+		}
+
+		template <class T, class... Args>
+		std::shared_ptr<T> make_pooled_shared(Args&&... args)
+		{
+			return make_pooled_shared_mode<T, TlsMode>(std::forward<Args>(args)...);
+		}
+
+		template <class T, class... Args>
+		std::shared_ptr<T> make_pooled_shared_singleton(Args&&... args)
+		{
+			return make_pooled_shared_mode<T, SingletonMode>(std::forward<Args>(args)...);
+		}
+
+
+		/*******************************************
+		 * intrusive shared pointer
+		 *  - T derives from RefCounted, no control block at all
+		 *  - no conversion to a base pointer, the slot belongs to Pool<T>
+		 *******************************************/
+		class RefCounted {
+		private:
+			template <class T, class Mode> friend class PooledRef;
+			std::atomic<uint32_t> ref_cnt_{0};
+
+		protected:
+			RefCounted() noexcept = default;
+			RefCounted(const RefCounted&) noexcept {}
+			RefCounted& operator=(const RefCounted&) noexcept { return *this; }
+		};
+
+		template <class T, class Mode = TlsMode>
+		class PooledRef {
+		private:
+			T* t_ = nullptr;
+
+		public:
+			PooledRef() noexcept = default;
+
+			explicit PooledRef(T* t) noexcept : t_(t)
+			{
+				acquire();
+			}
+
+			PooledRef(const PooledRef& rhs) noexcept : t_(rhs.t_)
+			{
+				acquire();
+			}
+
+			PooledRef(PooledRef&& rhs) noexcept : t_(rhs.t_)
+			{
+				rhs.t_ = nullptr;
+			}
+
+			~PooledRef()
+			{
+				release();
+			}
+
+			PooledRef& operator=(PooledRef rhs) noexcept
+			{
+				std::swap(t_, rhs.t_);
+				return *this;
+			}
+
+			void reset() noexcept
+			{
+				release();
+				t_ = nullptr;
+			}
+
+			T* get() const noexcept { return t_; }
+			T& operator*() const noexcept { return *t_; }
+			T* operator->() const noexcept { return t_; }
+			explicit operator bool() const noexcept { return t_ != nullptr; }
+
+			uint32_t use_count() const noexcept
+			{
+				return t_ ? t_->ref_cnt_.load(std::memory_order_relaxed) : 0;
+			}
+
+		private:
+			void acquire() noexcept
+			{
+				if (t_) t_->ref_cnt_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			void release() noexcept
+			{
+				if (t_ && t_->ref_cnt_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					destruct(t_);
+					ret_mode(t_, Mode());
+				}
+			}
+		};
+
+		template <class T, class Mode, class... Args>
+		PooledRef<T, Mode> make_pooled_ref_mode(Args&&... args)
+		{
+			static_assert(std::is_base_of<RefCounted, T>::value, "T must derive from RefCounted");
+
+			T* t = get_mode<T>(Mode());
+			try {
+				new (t) T (std::forward<Args>(args)...);
+			} catch (...) {
+				ret_mode(t, Mode());
+				throw;
+			}
+			return PooledRef<T, Mode>(t);
+		}
+
+		template <class T, class... Args>
+		PooledRef<T> make_pooled_ref(Args&&... args)
+		{
+			return make_pooled_ref_mode<T, TlsMode>(std::forward<Args>(args)...);
+		}
+
+		template <class T, class... Args>
+		PooledRef<T, SingletonMode> make_pooled_ref_singleton(Args&&... args)
+		{
+			return make_pooled_ref_mode<T, SingletonMode>(std::forward<Args>(args)...);
+		}
+
+
+#ifdef VAN_POOL_PMR
+		/*******************************************
+		 * polymorphic memory resource (c++17)
+		 *  - requests aligned to max_align_t or less up to size_class_max use the size classes
+		 *  - bigger or over aligned requests go to upstream
+		 *******************************************/
+		template <class Mode = TlsMode>
+		class PoolResource : public std::pmr::memory_resource {
+		private:
+			std::pmr::memory_resource* upstream_;
+
+		public:
+			explicit PoolResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+				: upstream_(upstream)
+			{
+			}
+
+			std::pmr::memory_resource* upstream() const noexcept
+			{
+				return upstream_;
+			}
+
+		protected:
+			void* do_allocate(size_t bytes, size_t align) override
+			{
+				if (bytes > size_class_max || align > alignof(std::max_align_t)) {
+					Fallback::count(Fallback::inst().resource_);
+					return upstream_->allocate(bytes, align);
+				}
+				return size_class_table<Mode>()[size_class_of(bytes)].get_();
+			}
+
+			void do_deallocate(void* p, size_t bytes, size_t align) override
+			{
+				if (bytes > size_class_max || align > alignof(std::max_align_t)) {
+					upstream_->deallocate(p, bytes, align);
+					return;
+				}
+				size_class_table<Mode>()[size_class_of(bytes)].ret_(p);
+			}
+
+			// pools are shared by mode, so any two resources of a mode can free each other's memory
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+			{
+				const PoolResource* res = dynamic_cast<const PoolResource*>(&other);
+				return res && res->upstream_ == upstream_;
+			}
+		};
+
+		inline PoolResource<TlsMode>* get_tls_resource() noexcept
+		{
+			static PoolResource<TlsMode> res;
+			return &res;
+		}
+
+		inline PoolResource<SingletonMode>* get_singleton_resource() noexcept
+		{
+			static PoolResource<SingletonMode> res;
+			return &res;
+		}
+#endif
+
+
+		/*******************************************
+		 * monitor
+		 *******************************************/
+		// per type : pool sums, peak_ is the sum of the pool peaks
+		// blocks abandoned by dead pools are summed in, pool_ does not count them
+		// rates are per second since the snapshot passed to Monitor::snapshot(prev), 0 otherwise
+		class Count : public PoolStat {
+			public:
+				uint64_t pool_ = 0;
+				double get_rate_ = 0;
+				double ret_rate_ = 0;
+		};
+
+		using Stat = std::unordered_map<std::type_index, Count>;
+
+		class PoolEntry {
+		public:
+			std::type_index tidx_;
+			const void* pool_;
+			PoolStat stat_;
+		};
+
+		class Snapshot {
+		public:
+			std::chrono::system_clock::time_point time_;
+			std::chrono::steady_clock::time_point steady_;		// rate intervals
+			Stat types_;
+			std::vector<PoolEntry> pools_;
+			FallbackStat fallback_;
+		};
+
+
+		// no state of its own : each consumer keeps the snapshot its rates are against
+		class Monitor {
+		public:
+			Monitor() = default;
+			Monitor(const Monitor&) = delete;
+			Monitor& operator=(const Monitor&) = delete;
+
+			static Monitor& inst()
+			{
+				static Monitor inst;
+				return inst;
+			}
+
+			Stat stat() noexcept
+			{
+				return collect(nullptr);
+			}
+
+			// types, every pool and the heap fallbacks from one pass
+			Snapshot snapshot() noexcept
+			{
+				Snapshot snap;
+				snap.time_ = std::chrono::system_clock::now();
+				snap.steady_ = std::chrono::steady_clock::now();
+				snap.types_ = collect(&snap.pools_);
+				snap.fallback_ = Fallback::inst().stat();
+				return snap;
+			}
+
+			// with get/ret rates since prev, the caller's own previous snapshot
+			Snapshot snapshot(const Snapshot& prev) noexcept
+			{
+				Snapshot snap = snapshot();
+				double sec = std::chrono::duration<double>(snap.steady_ - prev.steady_).count();
+				if (sec > 0) {
+					rates(snap.types_, prev.types_, sec);
+				}
+				return snap;
+			}
+
+			FallbackStat fallback() noexcept
+			{
+				return Fallback::inst().stat();
+			}
+
+			// ask every pool to shrink to bytes on its owner's next return
+			void request_trim(uint64_t bytes = 0) noexcept
+			{
+				Registry::inst().for_each([bytes](const std::type_info&, PoolBase* pool) {
+					pool->request_trim(bytes);
+				});
+			}
+
+		private:
+			static Stat collect(std::vector<PoolEntry>* pools) noexcept
+			{
+				Stat stat;
+				Registry::inst().for_each([&](const std::type_info& type, PoolBase* pool) {
+					std::type_index tidx(type);
+					PoolStat st;
+					pool->snapshot(st);
+					if (pools) pools->push_back(PoolEntry{tidx, pool, st});
+
+					Count& cnt = stat[tidx];
+					cnt.total_ += st.total_;
+					cnt.use_ += st.use_;
+					cnt.peak_ += st.peak_;
+					cnt.blocks_ += st.blocks_;
+					cnt.grows_ += st.grows_;
+					cnt.reserved_bytes_ += st.reserved_bytes_;
+					cnt.used_bytes_ += st.used_bytes_;
+					cnt.gets_ += st.gets_;
+					cnt.rets_ += st.rets_;
+					cnt.remote_rets_ += st.remote_rets_;
+					cnt.fallbacks_ += st.fallbacks_;
+					if (!pool->orphans()) ++cnt.pool_;
+				});
+				return stat;
+			}
+
+			// pools that died since prev take their counts with them
+			static void rates(Stat& stat, const Stat& prev, double sec) noexcept
+			{
+				for (auto& it : stat) {
+					auto last = prev.find(it.first);
+					if (last == prev.end()) continue;
+
+					Count& cnt = it.second;
+					const Count& old = last->second;
+					cnt.get_rate_ = (cnt.gets_ > old.gets_) ? (cnt.gets_ - old.gets_) / sec : 0;
+					cnt.ret_rate_ = (cnt.rets_ > old.rets_) ? (cnt.rets_ - old.rets_) / sec : 0;
+				}
+			}
+
+		};
+
+
+		/*******************************************
+		 * background trimmer
+		 *  - periodically requests every pool to shrink to keep_bytes
+		 *******************************************/
+		class Trimmer {
+		private:
+			std::mutex mutex_;
+			std::condition_variable cond_;
+			bool stop_ = false;
+			std::thread thread_;
+
+		public:
+			Trimmer(uint64_t keep_bytes, std::chrono::milliseconds period) noexcept
+			{
+				thread_ = std::thread([this, keep_bytes, period]() {
+					std::unique_lock<std::mutex> lock(mutex_);
+					while (!cond_.wait_for(lock, period, [this]() { return stop_; })) {
+						Monitor::inst().request_trim(keep_bytes);
+					}
+				});
+			}
+
+			~Trimmer() noexcept
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stop_ = true;
+				}
+				cond_.notify_one();
+				thread_.join();
+			}
+
+			Trimmer(const Trimmer&) = delete;
+			Trimmer& operator=(const Trimmer&) = delete;
+		};
+
+		/*******************************************
+		 * exporters
+		 *  - prometheus text format and json over one Snapshot
+		 *  - per type aggregates, per pool series on request (one per tls pool)
+		 *  - Sampler snapshots on its own thread, scrapers read the latest copy
+		 *******************************************/
+		// the same escapes cover prometheus label values and json strings
+		inline std::string escape(const std::string& s)
+		{
+			std::string out;
+			out.reserve(s.size());
+			for (char c : s) {
+				switch (c) {
+				case '\\': out += "\\\\"; break;
+				case '"': out += "\\\""; break;
+				case '\n': out += "\\n"; break;
+				default: out += c; break;
+				}
+			}
+			return out;
+		}
+
+		class StatField {
+		public:
+			const char* name_;
+			const char* help_;
+			const char* type_;
+			uint64_t PoolStat::* field_;
+		};
+
+		inline const StatField* stat_fields(size_t& cnt) noexcept
+		{
+			static const StatField fields[] = {
+				{ "objects", "Objects carved into blocks.", "gauge", &PoolStat::total_ },
+				{ "used_objects", "Objects handed out and not yet returned.", "gauge", &PoolStat::use_ },
+				{ "peak_used_objects", "High-water mark of used objects.", "gauge", &PoolStat::peak_ },
+				{ "blocks", "Blocks held.", "gauge", &PoolStat::blocks_ },
+				{ "reserved_bytes", "Bytes of the blocks held.", "gauge", &PoolStat::reserved_bytes_ },
+				{ "used_bytes", "Bytes of the used objects.", "gauge", &PoolStat::used_bytes_ },
+				{ "block_grows_total", "Blocks allocated.", "counter", &PoolStat::grows_ },
+				{ "gets_total", "Objects handed out.", "counter", &PoolStat::gets_ },
+				{ "rets_total", "Objects returned.", "counter", &PoolStat::rets_ },
+				{ "remote_rets_total", "Objects returned by another thread.", "counter", &PoolStat::remote_rets_ },
+				{ "provider_fallbacks_total", "Blocks taken from the heap after the provider failed.", "counter", &PoolStat::fallbacks_ },
+			};
+			cnt = sizeof(fields) / sizeof(fields[0]);
+			return fields;
+		}
+
+		inline void append(std::string& out, const char* fmt, ...)
+#if defined(__GNUG__)
+			__attribute__((format(printf, 2, 3)))
+#endif
+			;
+
+		// a line that does not fit the stack buffer (long container type names)
+		// is formatted again straight into out
+		inline void append(std::string& out, const char* fmt, ...)
+		{
+			char buf[512];
+			va_list args;
+			va_start(args, fmt);
+			va_list again;
+			va_copy(again, args);
+			int n = vsnprintf(buf, sizeof(buf), fmt, args);
+			va_end(args);
+
+			if (n > 0 && static_cast<size_t>(n) < sizeof(buf)) {
+				out.append(buf, n);
+			} else if (n > 0) {
+				size_t at = out.size();
+				out.resize(at + n + 1);
+				vsnprintf(&out[at], n + 1, fmt, again);
+				out.resize(at + n);
+			}
+			va_end(again);
+		}
+
+		inline std::string to_prometheus(const Snapshot& snap, bool per_pool = false)
+		{
+			std::string out;
+			size_t cnt = 0;
+			const StatField* fields = stat_fields(cnt);
+
+			append(out, "# HELP van_pool_pools Pools per type.\n# TYPE van_pool_pools gauge\n");
+			for (auto& it : snap.types_) {
+				append(out, "van_pool_pools{type=\"%s\"} %" PRIu64 "\n", escape(demangle(it.first.name())).c_str(), it.second.pool_);
+			}
+
+			for (size_t i=0; i<cnt; ++i) {
+				const StatField& f = fields[i];
+				append(out, "# HELP van_pool_%s %s\n# TYPE van_pool_%s %s\n", f.name_, f.help_, f.name_, f.type_);
+				for (auto& it : snap.types_) {
+					append(out, "van_pool_%s{type=\"%s\"} %" PRIu64 "\n", f.name_, escape(demangle(it.first.name())).c_str(), it.second.*f.field_);
+				}
+			}
+
+			if (per_pool) {
+				for (size_t i=0; i<cnt; ++i) {
+					const StatField& f = fields[i];
+					append(out, "# HELP van_pool_instance_%s %s\n# TYPE van_pool_instance_%s %s\n", f.name_, f.help_, f.name_, f.type_);
+					for (auto& e : snap.pools_) {
+						append(out, "van_pool_instance_%s{type=\"%s\",pool=\"%p\"} %" PRIu64 "\n", f.name_, escape(demangle(e.tidx_.name())).c_str(), e.pool_, e.stat_.*f.field_);
+					}
+				}
+			}
+
+			append(out, "# HELP van_pool_heap_fallbacks_total Requests no pool serves.\n# TYPE van_pool_heap_fallbacks_total counter\n");
+			append(out, "van_pool_heap_fallbacks_total{source=\"size_class\"} %" PRIu64 "\n", snap.fallback_.size_class_);
+			append(out, "van_pool_heap_fallbacks_total{source=\"allocator\"} %" PRIu64 "\n", snap.fallback_.allocator_);
+			append(out, "van_pool_heap_fallbacks_total{source=\"resource\"} %" PRIu64 "\n", snap.fallback_.resource_);
+			return out;
+		}
+
+		inline void append_json(std::string& out, const PoolStat& st)
+		{
+			size_t cnt = 0;
+			const StatField* fields = stat_fields(cnt);
+			for (size_t i=0; i<cnt; ++i) {
+				append(out, ",\"%s\":%" PRIu64, fields[i].name_, st.*fields[i].field_);
+			}
+		}
+
+		inline std::string to_json(const Snapshot& snap, bool per_pool = false)
+		{
+			std::string out;
+			long long ms = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(snap.time_.time_since_epoch()).count());
+			append(out, "{\"time_ms\":%lld,\"types\":[", ms);
+
+			bool first = true;
+			for (auto& it : snap.types_) {
+				append(out, "%s{\"type\":\"%s\",\"pools\":%" PRIu64, first ? "" : ",", escape(demangle(it.first.name())).c_str(), it.second.pool_);
+				append_json(out, it.second);
+				append(out, ",\"get_rate\":%.1f,\"ret_rate\":%.1f}", it.second.get_rate_, it.second.ret_rate_);
+				first = false;
+			}
+			out += "]";
+
+			if (per_pool) {
+				out += ",\"pools\":[";
+				first = true;
+				for (auto& e : snap.pools_) {
+					append(out, "%s{\"type\":\"%s\",\"pool\":\"%p\"", first ? "" : ",", escape(demangle(e.tidx_.name())).c_str(), e.pool_);
+					append_json(out, e.stat_);
+					out += "}";
+					first = false;
+				}
+				out += "]";
+			}
+
+			append(
+				out, ",\"heap_fallbacks\":{\"size_class\":%" PRIu64 ",\"allocator\":%" PRIu64 ",\"resource\":%" PRIu64 "}}",
+				snap.fallback_.size_class_, snap.fallback_.allocator_, snap.fallback_.resource_
+			);
+			return out;
+		}
+
+		class Sampler {
+		public:
+			using Func = std::function<void(const Snapshot&)>;
+
+		private:
+			std::mutex mutex_;
+			std::condition_variable cond_;
+			bool stop_ = false;
+			Snapshot latest_;
+			std::thread thread_;
+
+		public:
+			// func runs on the sampler thread after each snapshot, if given
+			Sampler(std::chrono::milliseconds period, Func func = Func())
+			{
+				latest_ = Monitor::inst().snapshot();
+				thread_ = std::thread([this, period, func]() {
+					std::unique_lock<std::mutex> lock(mutex_);
+					while (!cond_.wait_for(lock, period, [this]() { return stop_; })) {
+						lock.unlock();
+						// this thread is the only writer of latest_, reading it unlocked is safe
+						Snapshot snap = Monitor::inst().snapshot(latest_);
+						if (func) func(snap);
+						lock.lock();
+						latest_ = std::move(snap);
+					}
+				});
+			}
+
+			~Sampler() noexcept
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stop_ = true;
+				}
+				cond_.notify_one();
+				thread_.join();
+			}
+
+			Sampler(const Sampler&) = delete;
+			Sampler& operator=(const Sampler&) = delete;
+
+			Snapshot latest()
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return latest_;
+			}
+		};
+
+		static void print_stat() noexcept
+		{
+			Stat s = Monitor::inst().stat();
+
+			printf(
+				"%4s %-30s %6s %10s %10s %10s %7s %12s %12s %10s %8s\n",
+				"NO.", "CLASS", "POOL", "TOTAL", "USE", "PEAK", "BLOCKS", "RESERVED", "USED", "REMOTE", "FALLBACK"
+			);
 
 			int no = 0;
 			for (auto it : s) {
 				auto& tidx = it.first;
 				auto& cnt = it.second;
 				printf(
-					"%3d. %-30s %10" PRIu64" %10" PRIu64" %10" PRIu64"\n",
-					++no, tidx.name(), cnt.pool_, cnt.total_, cnt.use_
+					"%3d. %-30s %6" PRIu64" %10" PRIu64" %10" PRIu64" %10" PRIu64" %7" PRIu64" %12" PRIu64" %12" PRIu64" %10" PRIu64" %8" PRIu64"\n",
+					++no, demangle(tidx.name()).c_str(), cnt.pool_, cnt.total_, cnt.use_, cnt.peak_,
+					cnt.blocks_, cnt.reserved_bytes_, cnt.used_bytes_, cnt.remote_rets_, cnt.fallbacks_
 				);
 			}
+
+			FallbackStat fb = Monitor::inst().fallback();
+			printf(
+				"heap fallbacks : size class %" PRIu64", allocator %" PRIu64", resource %" PRIu64"\n",
+				fb.size_class_, fb.allocator_, fb.resource_
+			);
 		}
 
 	}
@@ -0,0 +1,303 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "pool.h"
+
+
+static int fail_cnt = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("  %s:%d : %s\n", __FILE__, __LINE__, #cond); \
+			++fail_cnt; \
+		} \
+	} while (0)
+
+
+struct Remote { char buf_[40]; };
+struct Orphan { char buf_[40]; };
+struct Trimmed { char buf_[40]; };
+struct Shared { char buf_[40]; };
+struct Mapped { char buf_[100]; };
+struct Checked { char buf_[48]; };
+
+namespace van {
+	namespace pool {
+		template <>
+		struct PoolCheck<Checked> {
+			static constexpr bool hardened = true;
+		};
+	}
+}
+
+
+template <class T>
+van::pool::Count count_of() noexcept
+{
+	van::pool::Stat stat = van::pool::Monitor::inst().stat();
+	auto it = stat.find(std::type_index(typeid(T)));
+	return (it != stat.end()) ? it->second : van::pool::Count();
+}
+
+
+// objects got on one thread come back through another thread's pool
+void test_remote_ret()
+{
+	const int CNT = 1000;
+	std::vector<Remote*> objs;
+	for (int i=0; i<CNT; ++i) {
+		objs.push_back(van::pool::get_tls<Remote>());
+	}
+
+	std::thread([&objs]() {
+		for (Remote* obj : objs) {
+			van::pool::ret_tls(obj);
+		}
+	}).join();
+
+	// the owner counts remote returns once it reclaims them
+	van::pool::Pool<Remote>& pool = van::pool::get_tls_pool<Remote>();
+	CHECK(pool.reserved_bytes() > 0);
+	pool.trim();
+
+	van::pool::PoolStat st;
+	pool.snapshot(st);
+	CHECK(st.use_ == 0);
+	CHECK(st.remote_rets_ == CNT);
+	CHECK(pool.reserved_bytes() == 0);
+}
+
+// a dead thread's blocks stay counted, are adopted by a getter, freed when empty
+void test_thread_exit()
+{
+	const int CNT = 1000;
+	std::vector<Orphan*> objs;
+	std::thread([&objs]() {
+		for (int i=0; i<CNT; ++i) {
+			objs.push_back(van::pool::get_tls<Orphan>());
+		}
+	}).join();
+
+	van::pool::Count cnt = count_of<Orphan>();
+	CHECK(cnt.pool_ == 0);
+	CHECK(cnt.use_ == CNT);
+	CHECK(cnt.reserved_bytes_ > 0);
+
+	// blocks that empty meanwhile are freed
+	for (int i=0; i<CNT/2; ++i) {
+		van::pool::ret_tls(objs[i]);
+	}
+	cnt = count_of<Orphan>();
+	uint64_t reserved = cnt.reserved_bytes_;
+	CHECK(cnt.use_ == CNT/2);
+	CHECK(reserved > 0);
+
+	// no new block : the abandoned ones are taken over
+	Orphan* obj = van::pool::get_tls<Orphan>();
+	cnt = count_of<Orphan>();
+	CHECK(cnt.pool_ == 1);
+	CHECK(cnt.reserved_bytes_ == reserved);
+	CHECK(cnt.use_ == CNT/2 + 1);
+
+	van::pool::ret_tls(obj);
+	for (int i=CNT/2; i<CNT; ++i) {
+		van::pool::ret_tls(objs[i]);
+	}
+	van::pool::get_tls_pool<Orphan>().trim();
+	cnt = count_of<Orphan>();
+	CHECK(cnt.use_ == 0);
+	CHECK(cnt.reserved_bytes_ == 0);
+
+	// a thread that exits with objects still out : its blocks go once the last one is back
+	objs.clear();
+	std::thread([&objs]() {
+		for (int i=0; i<CNT; ++i) {
+			objs.push_back(van::pool::get_tls<Orphan>());
+		}
+	}).join();
+	std::thread([&objs]() {
+		for (Orphan* o : objs) {
+			van::pool::ret_tls(o);
+		}
+	}).join();
+	CHECK(count_of<Orphan>().reserved_bytes_ == 0);
+}
+
+void test_trim()
+{
+	const int CNT = 10000;
+	std::vector<Trimmed*> objs;
+
+	van::pool::Pool<Trimmed> pool(0, van::pool::Growth::doubling());
+	for (int i=0; i<CNT; ++i) {
+		objs.push_back(pool.get());
+	}
+	for (Trimmed* obj : objs) {
+		pool.ret(obj);
+	}
+	uint64_t reserved = pool.reserved_bytes();
+	CHECK(reserved > 0);
+	CHECK(pool.trim() == reserved);
+	CHECK(pool.reserved_bytes() == 0);
+
+	// a block with a live object stays
+	Trimmed* kept = pool.get();
+	pool.trim();
+	CHECK(pool.reserved_bytes() > 0);
+	pool.ret(kept);
+	pool.trim();
+	CHECK(pool.reserved_bytes() == 0);
+
+	van::pool::LockFreePool<Shared> lf;
+	std::vector<Shared*> shared;
+	for (int i=0; i<CNT; ++i) {
+		shared.push_back(lf.get());
+	}
+	for (Shared* obj : shared) {
+		lf.ret(obj);
+	}
+	reserved = lf.base().reserved_bytes();
+	CHECK(reserved > 0);
+	CHECK(lf.trim() == reserved);
+	CHECK(lf.base().reserved_bytes() == 0);
+
+	// request_trim is applied by the next ret, here sent by a Trimmer
+	Shared* obj = lf.get();
+	CHECK(lf.base().reserved_bytes() > 0);
+	{
+		van::pool::Trimmer trimmer(0, std::chrono::milliseconds(10));
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	lf.ret(obj);
+	CHECK(lf.base().reserved_bytes() == 0);
+}
+
+void test_provider()
+{
+#ifdef VAN_POOL_MMAP
+	van::pool::Pool<Mapped> pool(10, van::pool::Growth::fixed(), van::pool::Provider::mapped());
+	van::pool::PoolStat st;
+	pool.snapshot(st);
+	CHECK(st.blocks_ == 1);
+	CHECK(st.reserved_bytes_ % van::pool::page_bytes() == 0);
+	CHECK(st.total_ > 10);
+#endif
+}
+
+void test_align()
+{
+	for (size_t size : { 1, 16, 24, 100, 1000, 4096 }) {
+		void* p = van::pool::alloc(size);
+		CHECK(reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t) == 0);
+		van::pool::dealloc(p, size);
+	}
+
+#ifdef VAN_POOL_PMR
+	uint64_t fallbacks = van::pool::Fallback::inst().stat().resource_;
+	std::pmr::memory_resource* res = van::pool::get_tls_resource();
+	void* p = res->allocate(100, alignof(std::max_align_t));
+	CHECK(reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t) == 0);
+	res->deallocate(p, 100, alignof(std::max_align_t));
+	CHECK(van::pool::Fallback::inst().stat().resource_ == fallbacks);
+#endif
+}
+
+
+static std::vector<van::pool::Hardened::Fault> faults;
+static bool type_ok = true;
+
+static void on_fault(van::pool::Hardened::Fault fault, const char* type, const void*)
+{
+	faults.push_back(fault);
+	type_ok = type_ok && strcmp(type, "Checked") == 0;
+}
+
+static bool faulted(van::pool::Hardened::Fault fault)
+{
+	bool hit = (faults.size() == 1 && faults[0] == fault);
+	faults.clear();
+	return hit;
+}
+
+void test_hardened()
+{
+	using Fault = van::pool::Hardened::Fault;
+	van::pool::Hardened::Handler prev = van::pool::Hardened::set_handler(&on_fault);
+
+	{
+		van::pool::Pool<Checked> pool;
+		Checked* obj = pool.get();
+		pool.ret(obj);
+		pool.ret(obj);
+		CHECK(faulted(Fault::double_ret));
+
+		std::vector<char> buf(sizeof(Checked) * 4, 0);
+		pool.ret(reinterpret_cast<Checked*>(buf.data()));
+		CHECK(faulted(Fault::foreign));
+
+		obj = pool.get();
+		memset(obj, 1, sizeof(Checked) + 1);
+		pool.ret(obj);
+		CHECK(faulted(Fault::overflow));
+
+		obj = pool.get();
+		pool.ret(obj);
+		obj->buf_[20] = 1;
+		obj = pool.get();
+		CHECK(faulted(Fault::use_after_ret));
+		pool.ret(obj);
+	}
+
+	{
+		van::pool::LockFreePool<Checked> pool;
+		Checked* kept = pool.get();
+		Checked* a = pool.get();
+		Checked* b = pool.get();
+		pool.ret(b);
+		pool.ret(a);
+
+		static char target[256];
+		void* link = target;
+		memcpy(a, &link, sizeof(link));
+		Checked* obj = pool.get();
+		CHECK(faulted(Fault::bad_link));
+		CHECK(obj != a && obj != b);
+
+		// the stack is cut at the broken link, not emptied of what comes back later
+		pool.ret(kept);
+		CHECK(pool.get() == kept);
+	}
+
+	CHECK(type_ok);
+	van::pool::Hardened::set_handler(prev);
+}
+
+
+int main()
+{
+	struct Test {
+		const char* name_;
+		void (*func_)();
+	};
+	const Test tests[] = {
+		{ "remote ret", &test_remote_ret },
+		{ "thread exit", &test_thread_exit },
+		{ "trim", &test_trim },
+		{ "provider", &test_provider },
+		{ "align", &test_align },
+		{ "hardened", &test_hardened },
+	};
+
+	for (const Test& test : tests) {
+		int before = fail_cnt;
+		test.func_();
+		printf("  %-20s : %s\n", test.name_, (fail_cnt == before) ? "ok" : "FAILED");
+	}
+
+	printf("\n%s\n", fail_cnt ? "FAILED" : "all passed");
+	return fail_cnt ? 1 : 0;
+}